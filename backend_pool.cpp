@@ -0,0 +1,196 @@
+#include "backend_pool.h"
+#include <iostream>
+#include <thread>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+using namespace std;
+
+int connect_to_backend(const BackendServer &backend)
+{
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0)
+    {
+        return -1;
+    }
+
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(backend.port);
+    inet_pton(AF_INET, backend.ip.c_str(), &server_addr.sin_addr);
+
+    if (connect(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+    {
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+static bool is_idle_connection_alive(int fd)
+{
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN | POLLRDHUP;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 0) == 0;
+}
+
+BackendPool::BackendPool(vector<BackendServer> &backend_list, size_t min_conns,
+                         size_t max_conns, int idle_timeout_ms)
+    : backends(backend_list), min_idle(min(min_conns, max_conns)), max_idle(max_conns),
+      idle_timeout(idle_timeout_ms)
+{
+    for (size_t i = 0; i < backends.size(); ++i)
+    {
+        slots.push_back(make_unique<Slot>());
+    }
+}
+
+BackendPool::~BackendPool()
+{
+    for (auto &backend : backends)
+    {
+        purge(backend);
+    }
+}
+
+BackendPool::Slot &BackendPool::slot_for(const BackendServer &backend)
+{
+    return *slots[&backend - backends.data()];
+}
+
+int BackendPool::checkout(BackendServer &backend)
+{
+    Slot &slot = slot_for(backend);
+    lock_guard<mutex> lock(slot.lock);
+
+    while (!slot.idle.empty())
+    {
+        int fd = slot.idle.back().fd;
+        slot.idle.pop_back();
+
+        if (is_idle_connection_alive(fd))
+        {
+            stats.hits++;
+            return fd;
+        }
+
+        close(fd);
+        stats.evictions++;
+    }
+
+    stats.misses++;
+    return -1;
+}
+
+int BackendPool::acquire(BackendServer &backend)
+{
+    int fd = checkout(backend);
+    if (fd >= 0)
+    {
+        return fd;
+    }
+    return connect_to_backend(backend);
+}
+
+void BackendPool::release(BackendServer &backend, int fd, bool reusable)
+{
+    if (fd < 0)
+    {
+        return;
+    }
+
+    if (reusable && backend.is_healthy())
+    {
+        Slot &slot = slot_for(backend);
+        lock_guard<mutex> lock(slot.lock);
+        if (slot.idle.size() < max_idle)
+        {
+            slot.idle.push_back({fd, chrono::steady_clock::now()});
+            return;
+        }
+    }
+
+    close(fd);
+}
+
+void BackendPool::purge(BackendServer &backend)
+{
+    Slot &slot = slot_for(backend);
+    lock_guard<mutex> lock(slot.lock);
+
+    for (auto &conn : slot.idle)
+    {
+        close(conn.fd);
+    }
+    stats.purged += slot.idle.size();
+    slot.idle.clear();
+}
+
+void BackendPool::evict_expired(Slot &slot)
+{
+    lock_guard<mutex> lock(slot.lock);
+    auto cutoff = chrono::steady_clock::now() - idle_timeout;
+
+    for (auto it = slot.idle.begin(); it != slot.idle.end();)
+    {
+        if (it->idle_since < cutoff || !is_idle_connection_alive(it->fd))
+        {
+            close(it->fd);
+            it = slot.idle.erase(it);
+            stats.evictions++;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void BackendPool::refill(BackendServer &backend)
+{
+    Slot &slot = slot_for(backend);
+
+    size_t missing;
+    {
+        lock_guard<mutex> lock(slot.lock);
+        missing = slot.idle.size() < min_idle ? min_idle - slot.idle.size() : 0;
+    }
+
+    for (size_t i = 0; i < missing && backend.is_healthy(); ++i)
+    {
+        int fd = connect_to_backend(backend);
+        if (fd < 0)
+        {
+            break;
+        }
+        release(backend, fd, true);
+    }
+}
+
+void BackendPool::run_maintenance(atomic<bool> &shutdown)
+{
+    while (!shutdown)
+    {
+        for (auto &backend : backends)
+        {
+            evict_expired(slot_for(backend));
+            if (backend.is_healthy())
+            {
+                refill(backend);
+            }
+        }
+
+        for (int i = 0; i < 5 && !shutdown; ++i)
+        {
+            this_thread::sleep_for(chrono::milliseconds(100));
+        }
+    }
+}
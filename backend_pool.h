@@ -0,0 +1,67 @@
+#ifndef BACKEND_POOL_H
+#define BACKEND_POOL_H
+
+#include "lb_config.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+struct PoolStats {
+    atomic<long long> hits{0};
+    atomic<long long> misses{0};
+    atomic<long long> evictions{0};
+    atomic<long long> purged{0};
+};
+
+// Idle keep-alive connections to each backend. Connections are handed out
+// most-recently-used first; the maintenance loop closes ones idle longer
+// than idle_timeout or closed by the backend, and pre-connects healthy
+// backends up to min_idle.
+class BackendPool {
+private:
+    struct IdleConnection {
+        int fd;
+        chrono::steady_clock::time_point idle_since;
+    };
+
+    struct Slot {
+        mutex lock;
+        deque<IdleConnection> idle;
+    };
+
+    vector<BackendServer> &backends;
+    vector<unique_ptr<Slot>> slots;
+    size_t min_idle;
+    size_t max_idle;
+    chrono::milliseconds idle_timeout;
+    PoolStats stats;
+
+    Slot &slot_for(const BackendServer &backend);
+    void evict_expired(Slot &slot);
+    void refill(BackendServer &backend);
+
+public:
+    BackendPool(vector<BackendServer> &backend_list, size_t min_conns, size_t max_conns,
+                int idle_timeout_ms);
+    ~BackendPool();
+
+    int checkout(BackendServer &backend);
+    int acquire(BackendServer &backend);
+    void release(BackendServer &backend, int fd, bool reusable);
+    void purge(BackendServer &backend);
+
+    void run_maintenance(atomic<bool> &shutdown);
+
+    const PoolStats &get_stats() const { return stats; }
+    size_t get_min_idle() const { return min_idle; }
+    size_t get_max_idle() const { return max_idle; }
+};
+
+int connect_to_backend(const BackendServer &backend);
+
+#endif
@@ -0,0 +1,1192 @@
+#include "file_store.h"
+#include "lb_algorithm.h"
+#include "protocol.h"
+#include "scheduler.h"
+#include "utils.h"
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <atomic>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+using namespace std;
+
+struct BenchArgs
+{
+  map<string, string> values;
+
+  string get(const string &key, const string &fallback) const
+  {
+    auto it = values.find(key);
+    return it == values.end() ? fallback : it->second;
+  }
+
+  long long get_int(const string &key, long long fallback) const
+  {
+    auto it = values.find(key);
+    return it == values.end() ? fallback : atoll(it->second.c_str());
+  }
+};
+
+static BenchArgs parse_bench_args(int argc, char *argv[], int first)
+{
+  BenchArgs args;
+  for (int i = first; i < argc; ++i)
+  {
+    string arg = argv[i];
+    if (arg.rfind("--", 0) == 0 && i + 1 < argc)
+    {
+      args.values[arg.substr(2)] = argv[++i];
+    }
+  }
+  return args;
+}
+
+static double percentile(vector<double> &samples, double p)
+{
+  if (samples.empty())
+  {
+    return 0.0;
+  }
+  size_t idx = min(samples.size() - 1, static_cast<size_t>(p * samples.size()));
+  nth_element(samples.begin(), samples.begin() + idx, samples.end());
+  return samples[idx];
+}
+
+// ---------------------------------------------------------------------------
+// load: closed-loop GET generator holding a fixed number of connections open.
+// ---------------------------------------------------------------------------
+
+struct LoadConn
+{
+  int fd = -1;
+  long long start_ns = 0;
+  long long first_byte_ns = 0;
+  size_t sent = 0;
+  string status;
+};
+
+struct LoadResult
+{
+  vector<double> latencies_ms;
+  vector<double> ttfb_ms;
+  long long errors = 0;
+  long long error_replies = 0;
+};
+
+static int open_nonblocking(const sockaddr_in &addr)
+{
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+  {
+    return -1;
+  }
+  if (connect(fd, (const struct sockaddr *)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS)
+  {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void load_worker(const sockaddr_in addr, int conns, const string request,
+                        atomic<bool> &stop, LoadResult &result)
+{
+  int ep = epoll_create1(EPOLL_CLOEXEC);
+  vector<LoadConn> pool(conns);
+  char sink[64 * 1024];
+
+  auto start_conn = [&](int idx)
+  {
+    LoadConn &c = pool[idx];
+    c.fd = open_nonblocking(addr);
+    c.sent = 0;
+    c.first_byte_ns = 0;
+    c.status.clear();
+    c.start_ns = get_current_time_ns();
+    if (c.fd < 0)
+    {
+      result.errors++;
+      return;
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLOUT;
+    ev.data.u32 = idx;
+    epoll_ctl(ep, EPOLL_CTL_ADD, c.fd, &ev);
+  };
+
+  for (int i = 0; i < conns; ++i)
+  {
+    start_conn(i);
+  }
+
+  vector<struct epoll_event> events(256);
+  while (!stop)
+  {
+    int n = epoll_wait(ep, events.data(), events.size(), 50);
+    for (int i = 0; i < n; ++i)
+    {
+      int idx = events[i].data.u32;
+      LoadConn &c = pool[idx];
+      bool done = false, failed = false;
+
+      if (c.sent < request.size())
+      {
+        ssize_t w = send(c.fd, request.data() + c.sent, request.size() - c.sent, MSG_NOSIGNAL);
+        if (w > 0)
+        {
+          c.sent += w;
+          if (c.sent == request.size())
+          {
+            struct epoll_event ev;
+            ev.events = EPOLLIN;
+            ev.data.u32 = idx;
+            epoll_ctl(ep, EPOLL_CTL_MOD, c.fd, &ev);
+          }
+        }
+        else if (errno != EAGAIN && errno != EINPROGRESS)
+        {
+          failed = true;
+        }
+      }
+      else
+      {
+        while (true)
+        {
+          ssize_t r = recv(c.fd, sink, sizeof(sink), 0);
+          if (r > 0)
+          {
+            if (c.first_byte_ns == 0)
+            {
+              c.first_byte_ns = get_current_time_ns();
+            }
+            if (c.status.size() < PROTOCOL_OK.size() + 1)
+            {
+              c.status.append(sink, min<size_t>(r, PROTOCOL_OK.size() + 1 - c.status.size()));
+            }
+            continue;
+          }
+          if (r == 0)
+          {
+            done = true;
+          }
+          else if (errno != EAGAIN)
+          {
+            failed = true;
+          }
+          break;
+        }
+      }
+
+      if (done || failed)
+      {
+        if (done && c.status != PROTOCOL_OK + "\n")
+        {
+          result.error_replies++;
+        }
+        else if (done)
+        {
+          result.latencies_ms.push_back(ns_to_ms(get_current_time_ns() - c.start_ns));
+          result.ttfb_ms.push_back(ns_to_ms(c.first_byte_ns - c.start_ns));
+        }
+        else
+        {
+          result.errors++;
+        }
+        close(c.fd);
+        start_conn(idx);
+      }
+    }
+  }
+
+  for (auto &c : pool)
+  {
+    if (c.fd >= 0)
+    {
+      close(c.fd);
+    }
+  }
+  close(ep);
+}
+
+static int bench_load(const BenchArgs &args)
+{
+  string host = args.get("host", "127.0.0.1");
+  int port = args.get_int("port", 8000);
+  int conns = args.get_int("conns", 64);
+  int threads = min<int>(conns, args.get_int("threads", 4));
+  int duration_s = args.get_int("duration", 10);
+  string file = args.get("file", "small_1.txt");
+  long long deadline_ms = args.get_int("deadline", 0);
+
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  inet_pton(AF_INET, host.c_str(), &addr.sin_addr);
+
+  string request = PROTOCOL_GET + " " + file + "\n";
+  if (deadline_ms > 0)
+  {
+    request = PROTOCOL_DEADLINE + " " + to_string(deadline_ms) + "\n" + request;
+  }
+  atomic<bool> stop(false);
+  vector<LoadResult> results(threads);
+  vector<thread> workers;
+  for (int t = 0; t < threads; ++t)
+  {
+    int share = conns / threads + (t < conns % threads ? 1 : 0);
+    workers.emplace_back(load_worker, addr, share, request, ref(stop), ref(results[t]));
+  }
+
+  this_thread::sleep_for(chrono::seconds(duration_s));
+  stop = true;
+  for (auto &w : workers)
+  {
+    w.join();
+  }
+
+  vector<double> all, ttfb;
+  long long errors = 0;
+  long long error_replies = 0;
+  for (auto &r : results)
+  {
+    all.insert(all.end(), r.latencies_ms.begin(), r.latencies_ms.end());
+    ttfb.insert(ttfb.end(), r.ttfb_ms.begin(), r.ttfb_ms.end());
+    errors += r.errors;
+    error_replies += r.error_replies;
+  }
+
+  cout << fixed << setprecision(3)
+       << "conns,requests,errors,error_replies,throughput_rps,p50_ms,p99_ms,p999_ms,ttfb_p50_ms,ttfb_p99_ms\n"
+       << conns << "," << all.size() << "," << errors << "," << error_replies << ","
+       << all.size() / static_cast<double>(duration_s) << ","
+       << percentile(all, 0.50) << "," << percentile(all, 0.99) << ","
+       << percentile(all, 0.999) << "," << percentile(ttfb, 0.50) << ","
+       << percentile(ttfb, 0.99) << endl;
+  return 0;
+}
+
+// ---------------------------------------------------------------------------
+// storm: new connection per request from many blocking threads; reports the
+// sustained connection rate.
+// ---------------------------------------------------------------------------
+
+static void storm_worker(const sockaddr_in addr, const string request, atomic<bool> &stop,
+                         atomic<long long> &completed, atomic<long long> &errors)
+{
+  char sink[4096];
+  while (!stop)
+  {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (const struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        send(fd, request.data(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size()))
+    {
+      errors++;
+      if (fd >= 0)
+      {
+        close(fd);
+      }
+      continue;
+    }
+
+    ssize_t r;
+    while ((r = recv(fd, sink, sizeof(sink), 0)) > 0)
+    {
+    }
+    close(fd);
+
+    if (r == 0)
+    {
+      completed++;
+    }
+    else
+    {
+      errors++;
+    }
+  }
+}
+
+static int bench_storm(const BenchArgs &args)
+{
+  string host = args.get("host", "127.0.0.1");
+  int port = args.get_int("port", 8000);
+  int threads = args.get_int("threads", 16);
+  int duration_s = args.get_int("duration", 10);
+  string request = args.get("request", PROTOCOL_GET + " small.txt") + "\n";
+
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  inet_pton(AF_INET, host.c_str(), &addr.sin_addr);
+
+  atomic<bool> stop(false);
+  atomic<long long> completed(0), errors(0);
+  vector<thread> workers;
+  for (int t = 0; t < threads; ++t)
+  {
+    workers.emplace_back(storm_worker, addr, request, ref(stop), ref(completed), ref(errors));
+  }
+
+  this_thread::sleep_for(chrono::seconds(duration_s));
+  stop = true;
+  for (auto &w : workers)
+  {
+    w.join();
+  }
+
+  cout << fixed << setprecision(1)
+       << "threads,connections,errors,connections_per_sec\n"
+       << threads << "," << completed << "," << errors << ","
+       << completed / static_cast<double>(duration_s) << endl;
+  return 0;
+}
+
+// Previous one-recv-per-byte reader, kept as the baseline for bench reader.
+static bool bytewise_recv_line(int sockfd, string &line, size_t &calls)
+{
+  line.clear();
+  char c;
+  while (true)
+  {
+    ssize_t received = recv(sockfd, &c, 1, 0);
+    calls++;
+    if (received <= 0)
+    {
+      return false;
+    }
+    if (c == '\n')
+    {
+      return true;
+    }
+    line += c;
+  }
+}
+
+static bool bytewise_recv_message(int sockfd, vector<string> &lines, size_t &calls)
+{
+  string line;
+  size_t size = 0;
+  if (!bytewise_recv_line(sockfd, line, calls) || !parse_size_line(line, size))
+  {
+    return false;
+  }
+
+  lines.clear();
+  size_t received = 0;
+  while (received < size)
+  {
+    if (!bytewise_recv_line(sockfd, line, calls))
+    {
+      return false;
+    }
+    received += line.length() + 1;
+    lines.push_back(line);
+  }
+  return bytewise_recv_line(sockfd, line, calls) && line == PROTOCOL_END;
+}
+
+static bool buffered_recv_message(ConnectionReader &reader, FileBlob &file)
+{
+  string line;
+  size_t size = 0;
+  return recv_line(reader, line) && parse_size_line(line, size) &&
+         recv_file(reader, size, file);
+}
+
+static FileBlob to_blob(const vector<string> &lines)
+{
+  FileBlob file;
+  for (const auto &line : lines)
+  {
+    file.append_line(line);
+  }
+  return file;
+}
+
+// Sends `iters` SIZE/body/END messages over a socketpair and reads them
+// back with the byte-at-a-time reader and with ConnectionReader.
+static int bench_reader(const BenchArgs &args)
+{
+  size_t file_bytes = args.get_int("size", 810000);
+  size_t line_bytes = max(2LL, args.get_int("line", 81));
+  int iters = args.get_int("iters", 20);
+  signal(SIGPIPE, SIG_IGN);
+
+  vector<string> file_lines(max<size_t>(1, file_bytes / line_bytes),
+                            string(line_bytes - 1, 'x'));
+  FileBlob file = to_blob(file_lines);
+  size_t payload = file.size();
+
+  cout << fixed << setprecision(3)
+       << "reader,file_bytes,lines,recv_calls_per_transfer,ms_per_transfer,mb_per_sec\n";
+
+  for (const string method : {"bytewise", "buffered"})
+  {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    {
+      cerr << "socketpair failed: " << strerror(errno) << endl;
+      return 1;
+    }
+
+    thread writer([&]()
+                  {
+      for (int i = 0; i < iters; ++i)
+      {
+        if (!send_line(fds[0], PROTOCOL_SIZE + " " + to_string(payload)) ||
+            !send_file(fds[0], file))
+        {
+          break;
+        }
+      } });
+
+    ConnectionReader reader(fds[1]);
+    size_t calls = 0;
+    int done = 0;
+    vector<string> lines;
+    FileBlob received;
+    long long start_ns = get_current_time_ns();
+    for (; done < iters; ++done)
+    {
+      bool ok = (method == "bytewise")
+                    ? bytewise_recv_message(fds[1], lines, calls) &&
+                          lines.size() == file_lines.size()
+                    : buffered_recv_message(reader, received) &&
+                          received.line_count() == file_lines.size();
+      if (!ok)
+      {
+        break;
+      }
+    }
+    double elapsed_ms = ns_to_ms(get_current_time_ns() - start_ns);
+    if (method == "buffered")
+    {
+      calls = reader.syscalls();
+    }
+
+    close(fds[1]);
+    writer.join();
+    close(fds[0]);
+
+    if (done != iters)
+    {
+      cerr << method << ": transfer " << done << " failed" << endl;
+      return 1;
+    }
+
+    cout << method << "," << payload << "," << file_lines.size() << ","
+         << calls / static_cast<double>(iters) << "," << elapsed_ms / iters << ","
+         << (payload * iters / 1e6) / (elapsed_ms / 1000.0) << endl;
+  }
+  return 0;
+}
+
+// Previous send path: one concatenated string per packet of `packet_lines`.
+static bool concat_send_file(int sockfd, const vector<string> &lines, size_t packet_lines)
+{
+  size_t i = 0;
+  while (i < lines.size())
+  {
+    string packet;
+    size_t end = min(i + packet_lines, lines.size());
+    for (size_t j = i; j < end; ++j)
+    {
+      packet += lines[j] + "\n";
+    }
+
+    size_t total_sent = 0;
+    while (total_sent < packet.size())
+    {
+      ssize_t sent = send(sockfd, packet.data() + total_sent, packet.size() - total_sent,
+                          MSG_NOSIGNAL);
+      if (sent <= 0)
+      {
+        return false;
+      }
+      total_sent += sent;
+    }
+    i = end;
+  }
+  return send_line(sockfd, PROTOCOL_END);
+}
+
+static long long thread_cpu_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1'000'000'000LL + ts.tv_nsec;
+}
+
+// Streams files of each --sizes entry over a TCP loopback connection with
+// the old per-packet string concatenation and with send_file's iovec path,
+// reporting throughput and sender CPU per byte.
+static int bench_send(const BenchArgs &args)
+{
+  string sizes = args.get("sizes", "4096,40960,409600,819200");
+  size_t line_bytes = max(2LL, args.get_int("line", 81));
+  size_t packet_bytes = args.get_int("packet-bytes", DEFAULT_PACKET_BYTES);
+  int packet_lines = args.get_int("p", 10);
+  int iters = args.get_int("iters", 200);
+  signal(SIGPIPE, SIG_IGN);
+
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t addr_len = sizeof(addr);
+  if (listener < 0 || bind(listener, (sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(listener, 1) < 0 || getsockname(listener, (sockaddr *)&addr, &addr_len) < 0)
+  {
+    cerr << "loopback listener failed: " << strerror(errno) << endl;
+    return 1;
+  }
+
+  cout << fixed << setprecision(3)
+       << "sender,file_bytes,iters,mb_per_sec,cpu_ns_per_byte\n";
+
+  stringstream size_list(sizes);
+  string size_token;
+  while (getline(size_list, size_token, ','))
+  {
+    size_t file_bytes = stoull(size_token);
+    vector<string> file_lines(max<size_t>(1, file_bytes / line_bytes),
+                              string(line_bytes - 1, 'x'));
+    FileBlob file = to_blob(file_lines);
+    size_t payload = file.size() + PROTOCOL_END.size() + 1;
+
+    struct Variant
+    {
+      string name;
+      function<bool(int)> send;
+    };
+    Packetization by_bytes;
+    by_bytes.max_bytes = packet_bytes;
+    Packetization by_lines;
+    by_lines.max_bytes = SIZE_MAX;
+    by_lines.max_lines = packet_lines;
+
+    vector<Variant> variants = {
+        {"concat_p" + to_string(packet_lines),
+         [&](int fd) { return concat_send_file(fd, file_lines, packet_lines); }},
+        {"writev_p" + to_string(packet_lines),
+         [&](int fd) { return send_file(fd, file, by_lines); }},
+        {"writev_" + to_string(packet_bytes / 1024) + "k",
+         [&](int fd) { return send_file(fd, file, by_bytes); }},
+    };
+
+    for (auto &variant : variants)
+    {
+      // Nagle would hold back each file's tail segment waiting for a
+      // delayed ACK and dominate the mid-size rows.
+      int sender = socket(AF_INET, SOCK_STREAM, 0);
+      int nodelay = 1;
+      setsockopt(sender, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+      if (connect(sender, (sockaddr *)&addr, sizeof(addr)) < 0)
+      {
+        cerr << "connect failed: " << strerror(errno) << endl;
+        return 1;
+      }
+      int receiver = accept(listener, nullptr, nullptr);
+
+      thread drain([&]()
+                   {
+        char buffer[READER_BUFFER_SIZE];
+        size_t remaining = payload * iters;
+        while (remaining > 0)
+        {
+          ssize_t received = recv(receiver, buffer, min(remaining, sizeof(buffer)), 0);
+          if (received <= 0)
+          {
+            break;
+          }
+          remaining -= received;
+        } });
+
+      long long start_ns = get_current_time_ns();
+      long long start_cpu = thread_cpu_ns();
+      bool ok = true;
+      for (int i = 0; i < iters && ok; ++i)
+      {
+        ok = variant.send(sender);
+      }
+      long long cpu_ns = thread_cpu_ns() - start_cpu;
+      drain.join();
+      double elapsed_s = (get_current_time_ns() - start_ns) / 1e9;
+
+      close(sender);
+      close(receiver);
+      if (!ok)
+      {
+        cerr << variant.name << ": send failed" << endl;
+        return 1;
+      }
+
+      double total = static_cast<double>(payload) * iters;
+      cout << variant.name << "," << payload << "," << iters << ","
+           << total / 1e6 / elapsed_s << "," << cpu_ns / total << endl;
+    }
+  }
+
+  close(listener);
+  return 0;
+}
+
+static vector<int> parse_int_list(const string &list)
+{
+  vector<int> values;
+  stringstream ss(list);
+  string token;
+  while (getline(ss, token, ','))
+  {
+    values.push_back(stoi(token));
+  }
+  return values;
+}
+
+// Mixed PUT/GET against an in-process FileStore; shards=1 is the old
+// single-lock layout.
+static int bench_store(const BenchArgs &args)
+{
+  vector<int> thread_counts = parse_int_list(args.get("threads", "1,2,4,8,16"));
+  vector<int> shard_counts = parse_int_list(args.get("shards", "1,16"));
+  int files = args.get_int("files", 1000);
+  int put_percent = args.get_int("put-percent", 10);
+  int duration_ms = args.get_int("duration-ms", 1000);
+
+  vector<string> names;
+  for (int i = 0; i < files; ++i)
+  {
+    names.push_back("file_" + to_string(i) + ".txt");
+  }
+  auto blob = make_shared<FileBlob>();
+  blob->append_line(string(80, 'x'));
+
+  cout << fixed << setprecision(1)
+       << "shards,threads,put_percent,ops,ops_per_sec,contended\n";
+
+  for (int shards : shard_counts)
+  {
+    for (int threads : thread_counts)
+    {
+      FileStore store(shards);
+      for (const auto &name : names)
+      {
+        store.put(name, blob);
+      }
+
+      atomic<bool> stop(false);
+      atomic<long long> ops(0);
+      vector<thread> workers;
+      for (int t = 0; t < threads; ++t)
+      {
+        workers.emplace_back([&, t]()
+                             {
+          unsigned int seed = 12345u + t;
+          long long local = 0;
+          while (!stop.load(memory_order_relaxed))
+          {
+            const string &name = names[rand_r(&seed) % names.size()];
+            if (static_cast<int>(rand_r(&seed) % 100) < put_percent)
+            {
+              store.put(name, blob);
+            }
+            else if (!store.get(name))
+            {
+              break;
+            }
+            ++local;
+          }
+          ops += local; });
+      }
+
+      this_thread::sleep_for(chrono::milliseconds(duration_ms));
+      stop = true;
+      for (auto &w : workers)
+      {
+        w.join();
+      }
+
+      StoreStats stats = store.stats();
+      cout << shards << "," << threads << "," << put_percent << "," << ops << ","
+           << ops * 1000.0 / duration_ms << "," << stats.contended << endl;
+    }
+  }
+  return 0;
+}
+
+// The previous FCFS queue: std::queue behind queue_mutex/queue_cv.
+class LockedFCFSScheduler : public Scheduler
+{
+public:
+  shared_ptr<Request> get_next_request() override
+  {
+    unique_lock<mutex> lock(queue_mutex);
+    queue_cv.wait(lock, [this]
+                  { return !request_queue.empty() || shutdown; });
+    if (request_queue.empty())
+    {
+      return nullptr;
+    }
+    auto req = request_queue.front();
+    request_queue.pop();
+    return req;
+  }
+};
+
+// Producers enqueue pre-built requests stamped with arrival_time; workers
+// dequeue and record the queueing delay. ns/op is wall time per request.
+static int bench_sched(const BenchArgs &args)
+{
+  vector<int> worker_counts = parse_int_list(args.get("workers", "4,8,16,32,64"));
+  int producers = args.get_int("producers", 2);
+  int ops = args.get_int("ops", 200000);
+
+  vector<shared_ptr<Request>> requests(ops);
+  for (auto &req : requests)
+  {
+    req = make_shared<Request>();
+  }
+
+  cout << fixed << setprecision(3)
+       << "queue,workers,producers,ops,ns_per_op,wait_p50_us,wait_p99_us,wait_p999_us\n";
+
+  for (const string kind : {"locked", "ring"})
+  {
+    for (int workers : worker_counts)
+    {
+      unique_ptr<Scheduler> sched;
+      if (kind == "locked")
+      {
+        sched = make_unique<LockedFCFSScheduler>();
+      }
+      else
+      {
+        sched = make_unique<FCFSScheduler>();
+      }
+
+      atomic<long long> consumed(0);
+      vector<vector<double>> waits(workers);
+      vector<thread> consumers;
+      for (int w = 0; w < workers; ++w)
+      {
+        consumers.emplace_back([&, w]()
+                               {
+          while (auto req = sched->get_next_request())
+          {
+            waits[w].push_back((get_current_time_ns() - req->arrival_time) / 1000.0);
+            consumed.fetch_add(1, memory_order_relaxed);
+          } });
+      }
+
+      long long start_ns = get_current_time_ns();
+      vector<thread> producer_threads;
+      for (int p = 0; p < producers; ++p)
+      {
+        producer_threads.emplace_back([&, p]()
+                                      {
+          for (int i = p; i < ops; i += producers)
+          {
+            requests[i]->arrival_time = get_current_time_ns();
+            sched->add_request(requests[i]);
+          } });
+      }
+      for (auto &t : producer_threads)
+      {
+        t.join();
+      }
+      while (consumed.load() < ops)
+      {
+        this_thread::yield();
+      }
+      long long elapsed_ns = get_current_time_ns() - start_ns;
+
+      sched->signal_shutdown();
+      for (auto &t : consumers)
+      {
+        t.join();
+      }
+
+      vector<double> all;
+      for (auto &w : waits)
+      {
+        all.insert(all.end(), w.begin(), w.end());
+      }
+      cout << kind << "," << workers << "," << producers << "," << ops << ","
+           << elapsed_ns / static_cast<double>(ops) << "," << percentile(all, 0.50) << ","
+           << percentile(all, 0.99) << "," << percentile(all, 0.999) << endl;
+    }
+  }
+  return 0;
+}
+
+// add_request + get_next_request pairs, single-threaded, so the queue never
+// blocks and the loop measures call overhead plus the queue itself.
+template <typename Target>
+static double time_sched_ops(Target *sched, const vector<shared_ptr<Request>> &requests,
+                             int rounds)
+{
+  long long start_ns = get_current_time_ns();
+  for (int r = 0; r < rounds; ++r)
+  {
+    for (const auto &req : requests)
+    {
+      sched->add_request(req);
+    }
+    for (size_t i = 0; i < requests.size(); ++i)
+    {
+      if (!sched->get_next_request())
+      {
+        return -1;
+      }
+    }
+  }
+  return (get_current_time_ns() - start_ns) / static_cast<double>(rounds * requests.size());
+}
+
+template <typename Target>
+static double time_lb_selects(Target *lb, int ops)
+{
+  uintptr_t sink = 0;
+  long long start_ns = get_current_time_ns();
+  for (int i = 0; i < ops; ++i)
+  {
+    sink += reinterpret_cast<uintptr_t>(lb->select_backend());
+  }
+  long long elapsed_ns = get_current_time_ns() - start_ns;
+  if (sink == 1)
+  {
+    cout << "";
+  }
+  return elapsed_ns / static_cast<double>(ops);
+}
+
+// Per-request dispatch cost: calls through Scheduler* / LBAlgorithm* (the
+// vtable, as before worker_loop<Policy> and Balancer<Algo>) against the
+// same calls on the final concrete type.
+static int bench_dispatch(const BenchArgs &args)
+{
+  int ops = args.get_int("ops", 1000000);
+  int batch = args.get_int("batch", 64);
+  int rounds = max(1, ops / batch);
+
+  vector<shared_ptr<Request>> requests;
+  for (int i = 0; i < batch; ++i)
+  {
+    auto req = make_shared<Request>();
+    req->type = RequestType::GET;
+    req->file_size = 1024;
+    requests.push_back(req);
+  }
+
+  cout << fixed << setprecision(2) << "target,path,ops,ns_per_op\n";
+
+  auto report = [&](const string &target, const string &path, double ns)
+  {
+    cout << target << "," << path << "," << rounds * batch << "," << ns << endl;
+  };
+
+  SchedulerOptions options;
+  options.quantum = 5;
+  for (SchedulingPolicy policy : {SchedulingPolicy::FCFS, SchedulingPolicy::RR})
+  {
+    string name = policy == SchedulingPolicy::FCFS ? "fcfs" : "rr";
+    unique_ptr<Scheduler> sched = create_scheduler(policy, options);
+    // Warm up allocations in the queue before timing either path.
+    time_sched_ops(sched.get(), requests, max(1, rounds / 10));
+    report(name, "virtual", time_sched_ops(sched.get(), requests, rounds));
+    if (policy == SchedulingPolicy::FCFS)
+    {
+      report(name, "direct",
+             time_sched_ops(dynamic_cast<FCFSScheduler *>(sched.get()), requests, rounds));
+    }
+    else
+    {
+      report(name, "direct",
+             time_sched_ops(dynamic_cast<RRScheduler *>(sched.get()), requests, rounds));
+    }
+    sched->signal_shutdown();
+  }
+
+  vector<BackendServer> backends(4);
+  for (size_t i = 0; i < backends.size(); ++i)
+  {
+    backends[i].id = static_cast<int>(i);
+    backends[i].healthy = true;
+    backends[i].avg_rtt_ms = 1.0 + i;
+  }
+  int lb_ops = rounds * batch;
+  unique_ptr<LBAlgorithm> rr = create_lb_algorithm(LBAlgorithmType::ROUND_ROBIN, backends);
+  report("lb-rr", "virtual", time_lb_selects(rr.get(), lb_ops));
+  report("lb-rr", "direct", time_lb_selects(dynamic_cast<RoundRobinLB *>(rr.get()), lb_ops));
+  unique_ptr<LBAlgorithm> lrt =
+      create_lb_algorithm(LBAlgorithmType::LEAST_RESPONSE_TIME, backends);
+  report("lb-lrt", "virtual", time_lb_selects(lrt.get(), lb_ops));
+  report("lb-lrt", "direct",
+         time_lb_selects(dynamic_cast<LeastResponseTimeLB *>(lrt.get()), lb_ops));
+  return 0;
+}
+
+// The previous round robin: a plain cursor behind a mutex.
+class LockedRoundRobinLB final : public LBAlgorithm
+{
+private:
+  mutex selection_mutex;
+  size_t current_index = 0;
+
+public:
+  explicit LockedRoundRobinLB(vector<BackendServer> &backend_list) : LBAlgorithm(backend_list) {}
+
+  BackendServer *select_backend() override
+  {
+    lock_guard<mutex> lock(selection_mutex);
+    for (size_t attempts = 0; attempts < backends.size(); ++attempts)
+    {
+      BackendServer &backend = backends[current_index];
+      current_index = (current_index + 1) % backends.size();
+      if (backend.is_healthy())
+      {
+        return &backend;
+      }
+    }
+    return &backends[0];
+  }
+
+  string get_name() const override { return "Locked Round Robin"; }
+};
+
+// Concurrent backend selection while a writer flips one backend's health
+// and updates RTTs every 100 us, as the health checker does.
+static int bench_select(const BenchArgs &args)
+{
+  vector<int> thread_counts = parse_int_list(args.get("threads", "1,2,4,8,16"));
+  int duration_ms = args.get_int("duration-ms", 500);
+
+  cout << fixed << setprecision(1) << "algo,threads,selects,selects_per_sec\n";
+
+  for (const string kind : {"locked", "rr", "lrt", "lc", "wlo", "p2c", "peak_ewma"})
+  {
+    for (int threads : thread_counts)
+    {
+      vector<BackendServer> backends(4);
+      for (size_t i = 0; i < backends.size(); ++i)
+      {
+        backends[i].id = static_cast<int>(i);
+        backends[i].avg_rtt_ms = 1.0 + i;
+      }
+
+      unique_ptr<LBAlgorithm> lb;
+      if (kind == "locked")
+      {
+        lb = make_unique<LockedRoundRobinLB>(backends);
+      }
+      else
+      {
+        lb = create_lb_algorithm(parse_lb_algorithm(kind), backends);
+      }
+
+      atomic<bool> stop(false);
+      atomic<long long> selects(0);
+      thread writer([&]()
+                    {
+        for (long long n = 0; !stop.load(memory_order_relaxed); ++n)
+        {
+          BackendServer &backend = backends[n % backends.size()];
+          backend.healthy.store(n % 8 != 0, memory_order_relaxed);
+          backend.avg_rtt_ms.store(1.0 + n % 5, memory_order_relaxed);
+          this_thread::sleep_for(chrono::microseconds(100));
+        } });
+
+      vector<thread> workers;
+      for (int t = 0; t < threads; ++t)
+      {
+        workers.emplace_back([&]()
+                             {
+          long long local = 0;
+          while (!stop.load(memory_order_relaxed))
+          {
+            if (!lb->select_backend())
+            {
+              break;
+            }
+            ++local;
+          }
+          selects += local; });
+      }
+
+      this_thread::sleep_for(chrono::milliseconds(duration_ms));
+      stop = true;
+      for (auto &w : workers)
+      {
+        w.join();
+      }
+      writer.join();
+
+      cout << kind << "," << threads << "," << selects << ","
+           << selects * 1000.0 / duration_ms << endl;
+    }
+  }
+  return 0;
+}
+
+// Key placement for --algo chash: share of keys per backend, how many keys
+// move when one backend goes down and comes back, and where a hot key's
+// GETs go when its owner is loaded, with one copy and with two.
+static int bench_chash(const BenchArgs &args)
+{
+  int keys = args.get_int("keys", 100000);
+  int backend_count = args.get_int("backends", 4);
+
+  vector<BackendServer> backends;
+  for (int i = 0; i < backend_count; ++i)
+  {
+    backends.emplace_back(i + 1, "127.0.0.1", 9001 + i);
+  }
+  ConsistentHash chash;
+
+  auto place = [&]()
+  {
+    vector<int> owners;
+    for (int k = 0; k < keys; ++k)
+    {
+      owners.push_back(chash.select(backends, "file_" + to_string(k) + ".txt", RequestType::PUT, 0)->id);
+    }
+    return owners;
+  };
+  auto moved = [&](const vector<int> &a, const vector<int> &b)
+  {
+    int count = 0;
+    for (int k = 0; k < keys; ++k)
+    {
+      count += (a[k] != b[k]);
+    }
+    return count;
+  };
+
+  vector<int> before = place();
+  vector<int> share(backend_count + 1, 0);
+  for (int owner : before)
+  {
+    share[owner]++;
+  }
+  cout << fixed << setprecision(2) << "backend,key_share_pct\n";
+  for (int i = 1; i <= backend_count; ++i)
+  {
+    cout << i << "," << share[i] * 100.0 / keys << endl;
+  }
+
+  cout << "\ndown_backend,moved_pct_on_down,owned_pct,moved_pct_on_up\n";
+  for (int down = 0; down < backend_count; ++down)
+  {
+    backends[down].healthy = false;
+    vector<int> during = place();
+    backends[down].healthy = true;
+    vector<int> after = place();
+    cout << down + 1 << "," << moved(before, during) * 100.0 / keys << ","
+         << share[down + 1] * 100.0 / keys << "," << moved(during, after) * 100.0 / keys << endl;
+  }
+
+  // Load the hot key's owner well past the bound while the others idle.
+  const string hot = "hot.txt";
+  int load = args.get_int("hot-load", 4 * ConsistentHash::SPILL_FLOOR);
+  cout << "\ncopies,owner,copy_backends,owner_in_flight,get_backend,put_backend,get_on_copy\n";
+  for (size_t copies : {size_t(1), size_t(2)})
+  {
+    chash.copies = copies;
+    vector<BackendServer *> placed = chash.place_copies(backends, hot, copies);
+    BackendServer *owner = placed.front();
+    owner->in_flight.store(load);
+    BackendServer *get = chash.select(backends, hot, RequestType::GET, 0);
+    BackendServer *put = chash.select(backends, hot, RequestType::PUT, 0);
+    owner->in_flight.store(0);
+
+    string ids;
+    for (BackendServer *copy : placed)
+    {
+      ids += (ids.empty() ? "" : " ") + to_string(copy->id);
+    }
+    bool on_copy = find(placed.begin(), placed.end(), get) != placed.end();
+    cout << copies << "," << owner->id << "," << ids << "," << load << "," << get->id << ","
+         << put->id << "," << (on_copy ? "yes" : "no") << endl;
+  }
+  return 0;
+}
+
+static void print_usage(const char *prog_name)
+{
+  cout << "Usage: " << prog_name << " <benchmark> [options]\n"
+       << "Benchmarks:\n"
+       << "  load      Closed-loop GETs over a fixed number of concurrent connections\n"
+       << "            --host <ip> --port <N> --conns <N> --threads <N>\n"
+       << "            --duration <s> --file <name> --deadline <ms>\n"
+       << "  storm     Connection storm: connect, send one request line, read to EOF\n"
+       << "            --host <ip> --port <N> --threads <N> --duration <s>\n"
+       << "            --request <line> (default \"GET small.txt\"; an unknown command\n"
+       << "            is rejected by the LB itself and excludes the backends)\n"
+       << "  reader    Socketpair receive path: byte-at-a-time recv vs ConnectionReader\n"
+       << "            --size <bytes> --line <bytes> --iters <N>\n"
+       << "  send      Loopback send path: per-packet string concat vs sendmsg iovecs\n"
+       << "            --sizes <b,b,...> --line <bytes> --packet-bytes <B> --p <N>\n"
+       << "            --iters <N>\n"
+       << "  store     In-process mixed PUT/GET on the sharded FileStore\n"
+       << "            --threads <n,n,...> --shards <n,n,...> --files <N>\n"
+       << "            --put-percent <P> --duration-ms <ms>\n"
+       << "  sched     FCFS queue overhead: mutex/condvar queue vs lock-free ring\n"
+       << "            --workers <n,n,...> --producers <N> --ops <N>\n"
+       << "  dispatch  Scheduler/LB call overhead: virtual base pointer vs final type\n"
+       << "            --ops <N> --batch <N>\n"
+       << "  select    Concurrent LB backend selection with health updates:\n"
+       << "            mutex round robin vs the lock-free algorithms\n"
+       << "            --threads <n,n,...> --duration-ms <ms>\n"
+       << "  chash     Maglev key placement: share per backend, keys moved\n"
+       << "            when each backend goes down and back up, and where a\n"
+       << "            hot key's GETs go when its owner is loaded\n"
+       << "            --keys <N> --backends <N> --hot-load <in-flight>\n";
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc < 2)
+  {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  map<string, function<int(const BenchArgs &)>> benchmarks = {
+      {"load", bench_load},
+      {"storm", bench_storm},
+      {"reader", bench_reader},
+      {"send", bench_send},
+      {"store", bench_store},
+      {"sched", bench_sched},
+      {"dispatch", bench_dispatch},
+      {"select", bench_select},
+      {"chash", bench_chash},
+  };
+
+  auto it = benchmarks.find(argv[1]);
+  if (it == benchmarks.end())
+  {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  return it->second(parse_bench_args(argc, argv, 2));
+}
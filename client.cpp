@@ -10,6 +10,7 @@
 #include <unistd.h>
 #include <cstring>
 #include <random>
+#include <sstream>
 #include <chrono>
 #include <sys/stat.h>
 
@@ -38,11 +39,29 @@ int connect_to_server(const string &ip, int port)
   return sock;
 }
 
+// Option lines sent ahead of each request.
+struct RequestOptions
+{
+  long long deadline_ms = 0;
+  string client_id;
+};
+
+bool send_options(int sock, const RequestOptions &options)
+{
+  if (options.deadline_ms > 0 &&
+      !send_line(sock, PROTOCOL_DEADLINE + " " + to_string(options.deadline_ms)))
+  {
+    return false;
+  }
+  return options.client_id.empty() ||
+         send_line(sock, PROTOCOL_CLIENT + " " + options.client_id);
+}
+
 bool send_put_request(const string &server_ip, int server_port,
-                      const string &filename)
+                      const string &filename, const RequestOptions &options = {})
 {
-  vector<string> lines;
-  if (!read_file_lines(filename, lines))
+  FileBlob file;
+  if (!read_file_lines(filename, file))
   {
     cerr << "[Client] Cannot read file: " << filename << endl;
     return false;
@@ -56,27 +75,28 @@ bool send_put_request(const string &server_ip, int server_port,
   }
 
   string base_filename = get_filename(filename);
-  if (!send_line(sock, PROTOCOL_PUT + " " + base_filename))
+  if (!send_options(sock, options) ||
+      !send_line(sock, PROTOCOL_PUT + " " + base_filename))
   {
     close(sock);
     return false;
   }
 
-  size_t file_size = get_file_size(lines);
-  if (!send_line(sock, PROTOCOL_SIZE + " " + to_string(file_size)))
+  if (!send_line(sock, PROTOCOL_SIZE + " " + to_string(file.size())))
   {
     close(sock);
     return false;
   }
 
-  if (!send_file(sock, lines, 1))
+  if (!send_file(sock, file))
   {
     close(sock);
     return false;
   }
 
+  ConnectionReader reader(sock);
   string response;
-  if (!recv_line(sock, response))
+  if (!recv_line(reader, response))
   {
     close(sock);
     return false;
@@ -97,7 +117,8 @@ bool send_put_request(const string &server_ip, int server_port,
 }
 
 bool send_get_request(const string &server_ip, int server_port,
-                      const string &filename, const string &output_path)
+                      const string &filename, const string &output_path,
+                      const RequestOptions &options = {})
 {
   int sock = connect_to_server(server_ip, server_port);
   if (sock < 0)
@@ -106,14 +127,16 @@ bool send_get_request(const string &server_ip, int server_port,
     return false;
   }
 
-  if (!send_line(sock, PROTOCOL_GET + " " + filename))
+  if (!send_options(sock, options) ||
+      !send_line(sock, PROTOCOL_GET + " " + filename))
   {
     close(sock);
     return false;
   }
 
+  ConnectionReader reader(sock);
   string response;
-  if (!recv_line(sock, response))
+  if (!recv_line(reader, response))
   {
     close(sock);
     return false;
@@ -127,17 +150,15 @@ bool send_get_request(const string &server_ip, int server_port,
   }
 
   string size_line;
-  if (!recv_line(sock, size_line))
+  size_t file_size = 0;
+  if (!recv_line(reader, size_line) || !parse_size_line(size_line, file_size))
   {
     close(sock);
     return false;
   }
 
-  size_t file_size;
-  sscanf(size_line.c_str(), "SIZE %zu", &file_size);
-
-  vector<string> lines;
-  if (!recv_file(sock, file_size, lines))
+  FileBlob file;
+  if (!recv_file(reader, file_size, file))
   {
     close(sock);
     return false;
@@ -145,19 +166,20 @@ bool send_get_request(const string &server_ip, int server_port,
 
   close(sock);
 
-  if (!write_file_lines(output_path, lines))
+  if (!write_file_lines(output_path, file))
   {
     return false;
   }
 
   cout << "[Client] GET " << filename << " - SUCCESS ("
-       << lines.size() << " lines)" << endl;
+       << file.line_count() << " lines)" << endl;
   return true;
 }
 
 void client_thread_func(int thread_id, const Config &config,
                         const vector<string> &test_files,
-                        int num_requests_per_thread)
+                        int num_requests_per_thread, const RequestOptions &options,
+                        int think_ms)
 {
   random_device rd;
   mt19937 gen(rd());
@@ -173,17 +195,20 @@ void client_thread_func(int thread_id, const Config &config,
 
     if (is_put)
     {
-      send_put_request(config.server_ip, config.server_port, filename);
+      send_put_request(config.server_ip, config.server_port, filename, options);
     }
     else
     {
       string output = "client_outputs/output_" + to_string(thread_id) + "_" +
                       to_string(i) + "_" + get_filename(filename);
       send_get_request(config.server_ip, config.server_port,
-                       get_filename(filename), output);
+                       get_filename(filename), output, options);
     }
 
-    this_thread::sleep_for(chrono::milliseconds(10));
+    if (think_ms > 0)
+    {
+      this_thread::sleep_for(chrono::milliseconds(think_ms));
+    }
   }
 }
 
@@ -243,7 +268,7 @@ void interactive_mode(const Config &config)
 }
 
 void test_mode(const Config &config, const vector<string> &test_files,
-               int num_requests_per_thread)
+               int num_requests_per_thread, const RequestOptions &options, int think_ms)
 {
   mkdir("client_outputs", 0755);
 
@@ -251,6 +276,9 @@ void test_mode(const Config &config, const vector<string> &test_files,
        << "Client threads: " << config.client_threads << "\n"
        << "Requests per thread: " << num_requests_per_thread << "\n"
        << "Test files: " << test_files.size() << "\n"
+       << "Deadline: " << (options.deadline_ms > 0 ? to_string(options.deadline_ms) + " ms" : "none") << "\n"
+       << "Client id: " << (options.client_id.empty() ? "(peer address)" : options.client_id) << "\n"
+       << "Think time: " << think_ms << " ms\n"
        << "========================\n"
        << endl;
 
@@ -260,7 +288,7 @@ void test_mode(const Config &config, const vector<string> &test_files,
   for (int i = 0; i < config.client_threads; ++i)
   {
     threads.emplace_back(client_thread_func, i, cref(config),
-                         cref(test_files), num_requests_per_thread);
+                         cref(test_files), num_requests_per_thread, cref(options), think_ms);
   }
 
   for (auto &t : threads)
@@ -285,6 +313,10 @@ void print_usage(const char *prog_name)
        << "  --interactive         Run in interactive mode\n"
        << "  --test <dir>          Run test mode with files from directory\n"
        << "  --requests <N>        Number of requests per thread in test mode (default: 10)\n"
+       << "  --deadline <MS>       Ask the backend to finish each test request within MS ms\n"
+       << "  --client-id <ID>      Send CLIENT <ID> so fair queuing groups this client's requests\n"
+       << "  --only <file>         Test mode requests only this file from the directory\n"
+       << "  --think <MS>          Pause between a thread's requests (default: 10)\n"
        << "  --help                Show this help message\n";
 }
 
@@ -310,6 +342,9 @@ int main(int argc, char *argv[])
   bool interactive = false;
   string test_dir;
   int num_requests = 10;
+  RequestOptions options;
+  string only_file;
+  int think_ms = 10;
 
   for (int i = 1; i < argc; ++i)
   {
@@ -326,6 +361,22 @@ int main(int argc, char *argv[])
     {
       num_requests = atoi(argv[++i]);
     }
+    else if (arg == "--deadline" && i + 1 < argc)
+    {
+      options.deadline_ms = atoll(argv[++i]);
+    }
+    else if (arg == "--client-id" && i + 1 < argc)
+    {
+      options.client_id = argv[++i];
+    }
+    else if (arg == "--only" && i + 1 < argc)
+    {
+      only_file = argv[++i];
+    }
+    else if (arg == "--think" && i + 1 < argc)
+    {
+      think_ms = atoi(argv[++i]);
+    }
     else if (arg == "--help")
     {
       print_usage(argv[0]);
@@ -345,7 +396,24 @@ int main(int argc, char *argv[])
       cerr << "Error: Cannot list files in " << test_dir << endl;
       return 1;
     }
-    test_mode(config, test_files, num_requests);
+    if (!only_file.empty())
+    {
+      vector<string> selected;
+      for (const auto &file : test_files)
+      {
+        if (get_filename(file) == only_file)
+        {
+          selected.push_back(file);
+        }
+      }
+      if (selected.empty())
+      {
+        cerr << "Error: " << only_file << " not found in " << test_dir << endl;
+        return 1;
+      }
+      test_files = selected;
+    }
+    test_mode(config, test_files, num_requests, options, think_ms);
   }
   else
   {
@@ -24,42 +24,86 @@ def analyze_metrics(metrics_file, algo_name):
     
     return stats, df
 
-def compare_algorithms(rr_metrics, lrt_metrics, output_dir):
+ALGORITHM_NAMES = {
+    'rr': 'Round Robin',
+    'lrt': 'Least Response Time',
+    'lc': 'Least Connections',
+    'wlo': 'Weighted Least Outstanding',
+    'p2c': 'Power of Two Choices',
+    'peak_ewma': 'Peak EWMA',
+    'chash': 'Consistent Hash',
+    'sita': 'Size Interval',
+}
+
+def algorithm_label(metrics_file):
+    # run_lb_experiments.sh names files <exp>_<algo>_<run>_metrics.log
+    stem = Path(metrics_file).stem
+    for algo in sorted(ALGORITHM_NAMES, key=len, reverse=True):
+        if f"_{algo}_" in f"_{stem}_":
+            return ALGORITHM_NAMES[algo]
+    return stem
+
+def compare_algorithms(metrics_files, output_dir):
     
     print("\n" + "="*70)
     print("LOAD BALANCING ALGORITHM COMPARISON")
     print("="*70)
     
-    rr_stats, rr_df = analyze_metrics(rr_metrics, "Round Robin")
-    lrt_stats, lrt_df = analyze_metrics(lrt_metrics, "Least Response Time")
+    results = [analyze_metrics(f, algorithm_label(f)) for f in metrics_files]
+    labels = [stats['algorithm'] for stats, _ in results]
+    col = max(20, max(len(label) for label in labels) + 2)
     
     print("\nResponse Time Statistics:")
-    print(f"{'Metric':<30} {'Round Robin':<20} {'Least Response Time':<20}")
-    print("-" * 70)
-    print(f"{'Total Requests':<30} {rr_stats['total_requests']:<20} {lrt_stats['total_requests']:<20}")
-    print(f"{'Mean Response Time (ms)':<30} {rr_stats['mean_response_time']:<20.2f} {lrt_stats['mean_response_time']:<20.2f}")
-    print(f"{'Median Response Time (ms)':<30} {rr_stats['median_response_time']:<20.2f} {lrt_stats['median_response_time']:<20.2f}")
-    print(f"{'Std Dev (ms)':<30} {rr_stats['std_response_time']:<20.2f} {lrt_stats['std_response_time']:<20.2f}")
-    print(f"{'P95 Response Time (ms)':<30} {rr_stats['p95_response_time']:<20.2f} {lrt_stats['p95_response_time']:<20.2f}")
-    print(f"{'P99 Response Time (ms)':<30} {rr_stats['p99_response_time']:<20.2f} {lrt_stats['p99_response_time']:<20.2f}")
+    print(f"{'Metric':<30}" + "".join(f"{label:<{col}}" for label in labels))
+    print("-" * (30 + col * len(labels)))
+    rows = [
+        ('Total Requests', 'total_requests', ''),
+        ('Mean Response Time (ms)', 'mean_response_time', '.2f'),
+        ('Median Response Time (ms)', 'median_response_time', '.2f'),
+        ('Std Dev (ms)', 'std_response_time', '.2f'),
+        ('P95 Response Time (ms)', 'p95_response_time', '.2f'),
+        ('P99 Response Time (ms)', 'p99_response_time', '.2f'),
+    ]
+    for title, key, fmt in rows:
+        print(f"{title:<30}" + "".join(f"{stats[key]:<{col}{fmt}}" for stats, _ in results))
     
     print("\nBackend Distribution:")
-    print(f"{'Backend':<15} {'Round Robin':<20} {'Least Response Time':<20}")
-    print("-" * 55)
-    all_backends = set(rr_stats['backend_distribution'].keys()) | set(lrt_stats['backend_distribution'].keys())
+    print(f"{'Backend':<15}" + "".join(f"{label:<{col}}" for label in labels))
+    print("-" * (15 + col * len(labels)))
+    all_backends = set()
+    for stats, _ in results:
+        all_backends |= set(stats['backend_distribution'].keys())
     for backend in sorted(all_backends):
-        rr_count = rr_stats['backend_distribution'].get(backend, 0)
-        lrt_count = lrt_stats['backend_distribution'].get(backend, 0)
-        rr_pct = rr_count / rr_stats['total_requests'] * 100
-        lrt_pct = lrt_count / lrt_stats['total_requests'] * 100
-        print(f"{'Backend ' + str(backend):<15} {rr_count:>5} ({rr_pct:>5.1f}%)     {lrt_count:>5} ({lrt_pct:>5.1f}%)")
+        cells = []
+        for stats, _ in results:
+            count = stats['backend_distribution'].get(backend, 0)
+            pct = count / stats['total_requests'] * 100
+            cells.append(f"{f'{count:>5} ({pct:>5.1f}%)':<{col}}")
+        print(f"{'Backend ' + str(backend):<15}" + "".join(cells))
+    
+    size_buckets = [(0, 4096, '<=4K'), (4096, 65536, '4K-64K'),
+                    (65536, 262144, '64K-256K'), (262144, float('inf'), '>256K')]
+    if all('file_size' in df.columns for _, df in results):
+        print("\nResponse Time by File Size (p50 / p99 ms):")
+        print(f"{'Size':<15}" + "".join(f"{label:<{col}}" for label in labels))
+        print("-" * (15 + col * len(labels)))
+        for low, high, title in size_buckets:
+            cells = []
+            for _, df in results:
+                times = df[(df['file_size'] > low if low else df['file_size'] >= 0) &
+                           (df['file_size'] <= high)]['response_time_ms']
+                cell = f"{times.median():.1f} / {times.quantile(0.99):.1f}" if len(times) else "-"
+                cells.append(f"{cell:<{col}}")
+            print(f"{title:<15}" + "".join(cells))
     
     fig, axes = plt.subplots(2, 3, figsize=(18, 10))
-    fig.suptitle('Algorithm Comparison: Round Robin vs Least Response Time', fontsize=16)
+    fig.suptitle('Algorithm Comparison: ' + ' vs '.join(labels), fontsize=16)
+    width = 0.8 / len(results)
+    offsets = [(i - (len(results) - 1) / 2) * width for i in range(len(results))]
     
     ax1 = axes[0, 0]
-    ax1.hist([rr_df['response_time_ms'], lrt_df['response_time_ms']], 
-             bins=30, label=['Round Robin', 'Least Response Time'], alpha=0.7)
+    ax1.hist([df['response_time_ms'] for _, df in results], 
+             bins=30, label=labels, alpha=0.7)
     ax1.set_xlabel('Response Time (ms)')
     ax1.set_ylabel('Frequency')
     ax1.set_title('Response Time Distribution')
@@ -68,13 +112,10 @@ def compare_algorithms(rr_metrics, lrt_metrics, output_dir):
     
     ax2 = axes[0, 1]
     backends = sorted(all_backends)
-    rr_counts = [rr_stats['backend_distribution'].get(b, 0) for b in backends]
-    lrt_counts = [lrt_stats['backend_distribution'].get(b, 0) for b in backends]
-    
     x = np.arange(len(backends))
-    width = 0.35
-    ax2.bar(x - width/2, rr_counts, width, label='Round Robin', alpha=0.7)
-    ax2.bar(x + width/2, lrt_counts, width, label='Least Response Time', alpha=0.7)
+    for (stats, _), offset, label in zip(results, offsets, labels):
+        counts = [stats['backend_distribution'].get(b, 0) for b in backends]
+        ax2.bar(x + offset, counts, width, label=label, alpha=0.7)
     ax2.set_xlabel('Backend')
     ax2.set_ylabel('Number of Requests')
     ax2.set_title('Request Distribution Across Backends')
@@ -84,43 +125,40 @@ def compare_algorithms(rr_metrics, lrt_metrics, output_dir):
     ax2.grid(True, alpha=0.3, axis='y')
     
     ax3 = axes[0, 2]
-    ax3.boxplot([rr_df['response_time_ms'], lrt_df['response_time_ms']], 
-                labels=['Round Robin', 'LRT'])
+    ax3.boxplot([df['response_time_ms'] for _, df in results], labels=labels)
     ax3.set_ylabel('Response Time (ms)')
     ax3.set_title('Response Time Comparison')
+    ax3.tick_params(axis='x', labelrotation=20)
     ax3.grid(True, alpha=0.3, axis='y')
     
     ax4 = axes[1, 0]
-    rr_df_sorted = rr_df.sort_values('timestamp_ms')
-    rr_df_sorted['request_num'] = range(len(rr_df_sorted))
-    ax4.scatter(rr_df_sorted['request_num'], rr_df_sorted['response_time_ms'], 
-               alpha=0.5, s=10)
+    for (_, df), label in zip(results, labels):
+        df_sorted = df.sort_values('timestamp_ms')
+        ax4.scatter(range(len(df_sorted)), df_sorted['response_time_ms'], 
+                   alpha=0.5, s=10, label=label)
     ax4.set_xlabel('Request Number')
     ax4.set_ylabel('Response Time (ms)')
-    ax4.set_title('Round Robin: Response Time Over Requests')
+    ax4.set_title('Response Time Over Requests')
+    ax4.legend()
     ax4.grid(True, alpha=0.3)
     
     ax5 = axes[1, 1]
-    lrt_df_sorted = lrt_df.sort_values('timestamp_ms')
-    lrt_df_sorted['request_num'] = range(len(lrt_df_sorted))
-    ax5.scatter(lrt_df_sorted['request_num'], lrt_df_sorted['response_time_ms'], 
-               alpha=0.5, s=10, color='orange')
-    ax5.set_xlabel('Request Number')
-    ax5.set_ylabel('Response Time (ms)')
-    ax5.set_title('Least Response Time: Response Time Over Requests')
+    for (_, df), label in zip(results, labels):
+        times = np.sort(df['response_time_ms'].values)
+        ax5.plot(times, np.arange(1, len(times) + 1) / len(times), label=label)
+    ax5.set_xlabel('Response Time (ms)')
+    ax5.set_ylabel('Fraction of Requests')
+    ax5.set_title('Response Time CDF')
+    ax5.legend()
     ax5.grid(True, alpha=0.3)
     
     ax6 = axes[1, 2]
     metrics = ['Mean', 'Median', 'P95', 'P99']
-    rr_values = [rr_stats['mean_response_time'], rr_stats['median_response_time'],
-                 rr_stats['p95_response_time'], rr_stats['p99_response_time']]
-    lrt_values = [lrt_stats['mean_response_time'], lrt_stats['median_response_time'],
-                  lrt_stats['p95_response_time'], lrt_stats['p99_response_time']]
-    
     x = np.arange(len(metrics))
-    width = 0.35
-    ax6.bar(x - width/2, rr_values, width, label='Round Robin', alpha=0.7)
-    ax6.bar(x + width/2, lrt_values, width, label='Least Response Time', alpha=0.7)
+    for (stats, _), offset, label in zip(results, offsets, labels):
+        values = [stats['mean_response_time'], stats['median_response_time'],
+                  stats['p95_response_time'], stats['p99_response_time']]
+        ax6.bar(x + offset, values, width, label=label, alpha=0.7)
     ax6.set_ylabel('Response Time (ms)')
     ax6.set_title('Response Time Metrics Comparison')
     ax6.set_xticks(x)
@@ -138,25 +176,21 @@ def compare_algorithms(rr_metrics, lrt_metrics, output_dir):
 
 def main():
     if len(sys.argv) < 3:
-        print("Usage: python3 compare_algorithms.py <rr_metrics.log> <lrt_metrics.log>")
+        print("Usage: python3 compare_algorithms.py <metrics.log> <metrics.log> [<metrics.log> ...]")
         print("\nExample:")
-        print("  python3 compare_algorithms.py results_lb/exp1_rr_c8_metrics.log results_lb/exp1_lrt_c8_metrics.log")
+        print("  python3 compare_algorithms.py results_lb/exp1_rr_c8_metrics.log results_lb/exp1_lrt_c8_metrics.log \\")
+        print("      results_lb/exp1_p2c_c8_metrics.log results_lb/exp1_peak_ewma_c8_metrics.log")
         sys.exit(1)
     
-    rr_metrics = sys.argv[1]
-    lrt_metrics = sys.argv[2]
-    
-    if not Path(rr_metrics).exists():
-        print(f"Error: File not found: {rr_metrics}")
-        sys.exit(1)
-    
-    if not Path(lrt_metrics).exists():
-        print(f"Error: File not found: {lrt_metrics}")
-        sys.exit(1)
+    metrics_files = sys.argv[1:]
+    for metrics_file in metrics_files:
+        if not Path(metrics_file).exists():
+            print(f"Error: File not found: {metrics_file}")
+            sys.exit(1)
     
-    output_dir = Path(rr_metrics).parent
+    output_dir = Path(metrics_files[0]).parent
     
-    compare_algorithms(rr_metrics, lrt_metrics, output_dir)
+    compare_algorithms(metrics_files, output_dir)
 
 if __name__ == "__main__":
-    main()
\ No newline at end of file
+    main()
@@ -0,0 +1,62 @@
+#include "file_blob.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+void FileBlob::reserve(size_t bytes, size_t lines)
+{
+  data.reserve(bytes);
+  offsets.reserve(lines);
+}
+
+void FileBlob::clear()
+{
+  data.clear();
+  offsets.clear();
+}
+
+void FileBlob::append_line(string_view line)
+{
+  offsets.push_back(static_cast<uint32_t>(data.size()));
+  data.append(line);
+  data.push_back('\n');
+}
+
+void FileBlob::assign(string bytes)
+{
+  data = move(bytes);
+  if (!data.empty() && data.back() != '\n')
+  {
+    data.push_back('\n');
+  }
+
+  offsets.clear();
+  size_t pos = 0;
+  while (pos < data.size())
+  {
+    offsets.push_back(static_cast<uint32_t>(pos));
+    const char *eol = static_cast<const char *>(
+        memchr(data.data() + pos, '\n', data.size() - pos));
+    pos = (eol - data.data()) + 1;
+  }
+}
+
+string_view FileBlob::line(size_t index) const
+{
+  size_t begin = offsets[index];
+  return string_view(data).substr(begin, line_offset(index + 1) - begin - 1);
+}
+
+// Start of line `index`; line_count() maps to size().
+size_t FileBlob::line_offset(size_t index) const
+{
+  return index < offsets.size() ? offsets[index] : data.size();
+}
+
+// Index of the line containing byte `offset`.
+size_t FileBlob::line_at_offset(size_t offset) const
+{
+  auto it = upper_bound(offsets.begin(), offsets.end(), offset);
+  return it == offsets.begin() ? 0 : static_cast<size_t>(it - offsets.begin()) - 1;
+}
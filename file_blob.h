@@ -0,0 +1,36 @@
+#ifndef FILE_BLOB_H
+#define FILE_BLOB_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+// A text file as one contiguous buffer of '\n'-terminated lines plus the
+// offset where each line starts. size() is the wire size used in SIZE
+// lines, and bytes() can be sent with a single write.
+class FileBlob {
+private:
+    string data;
+    vector<uint32_t> offsets;
+
+public:
+    void reserve(size_t bytes, size_t lines);
+    void clear();
+
+    void append_line(string_view line);
+    void assign(string bytes);
+
+    size_t size() const { return data.size(); }
+    size_t line_count() const { return offsets.size(); }
+    bool empty() const { return offsets.empty(); }
+
+    string_view bytes() const { return data; }
+    string_view line(size_t index) const;
+    size_t line_offset(size_t index) const;
+    size_t line_at_offset(size_t offset) const;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include "file_store.h"
+#include <functional>
+#include <mutex>
+
+using namespace std;
+
+FileStore::FileStore(size_t shard_count)
+{
+    for (size_t i = 0; i < max<size_t>(shard_count, 1); ++i)
+    {
+        shards.push_back(make_unique<Shard>());
+    }
+}
+
+size_t FileStore::hash_name(string_view name)
+{
+    return hash<string_view>()(name);
+}
+
+// The table buckets on the low bits of the hash, so pick the shard from
+// the high bits to keep the two independent.
+FileStore::Shard &FileStore::shard_for(size_t hash) const
+{
+    return *shards[((hash >> 32) ^ (hash >> 17)) % shards.size()];
+}
+
+void FileStore::put(string_view name, shared_ptr<const FileBlob> file)
+{
+    size_t hash = hash_name(name);
+    Shard &shard = shard_for(hash);
+
+    unique_lock<shared_mutex> guard(shard.lock, try_to_lock);
+    if (!guard.owns_lock())
+    {
+        shard.contended++;
+        guard.lock();
+    }
+    shard.writes++;
+
+    auto it = shard.entries.find(Key{name, hash});
+    if (it != shard.entries.end())
+    {
+        shard.bytes -= it->second->file->size();
+        shard.bytes += file->size();
+        it->second->file = move(file);
+        return;
+    }
+
+    auto entry = make_unique<Entry>();
+    entry->name.assign(name);
+    entry->file = move(file);
+    shard.bytes += entry->file->size();
+
+    Key key{entry->name, hash};
+    shard.entries.emplace(key, move(entry));
+}
+
+shared_ptr<const FileBlob> FileStore::get(string_view name) const
+{
+    size_t hash = hash_name(name);
+    Shard &shard = shard_for(hash);
+
+    shared_lock<shared_mutex> guard(shard.lock, try_to_lock);
+    if (!guard.owns_lock())
+    {
+        shard.contended++;
+        guard.lock();
+    }
+    shard.reads++;
+
+    auto it = shard.entries.find(Key{name, hash});
+    if (it == shard.entries.end())
+    {
+        return nullptr;
+    }
+    return it->second->file;
+}
+
+StoreStats FileStore::stats() const
+{
+    StoreStats total;
+    for (const auto &shard : shards)
+    {
+        ShardStats s;
+        {
+            shared_lock<shared_mutex> guard(shard->lock);
+            s.entries = shard->entries.size();
+            s.bytes = shard->bytes;
+        }
+        s.reads = shard->reads;
+        s.writes = shard->writes;
+        s.contended = shard->contended;
+
+        total.entries += s.entries;
+        total.bytes += s.bytes;
+        total.contended += s.contended;
+        total.shards.push_back(s);
+    }
+    return total;
+}
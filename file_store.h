@@ -0,0 +1,84 @@
+#ifndef FILE_STORE_H
+#define FILE_STORE_H
+
+#include "file_blob.h"
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+struct ShardStats {
+    size_t entries = 0;
+    size_t bytes = 0;
+    long long reads = 0;
+    long long writes = 0;
+    long long contended = 0;
+};
+
+struct StoreStats {
+    size_t entries = 0;
+    size_t bytes = 0;
+    long long contended = 0;
+    vector<ShardStats> shards;
+};
+
+// Hash-partitioned file storage. Each shard has its own reader-writer lock
+// and table; a name is hashed once and that hash picks the shard and the
+// bucket. Values are immutable snapshots, so a GET keeps sending the blob
+// it looked up even if a PUT replaces the entry meanwhile.
+class FileStore {
+private:
+    struct Key {
+        string_view name;
+        size_t hash;
+    };
+
+    struct KeyHash {
+        size_t operator()(const Key &key) const { return key.hash; }
+    };
+
+    struct KeyEqual {
+        bool operator()(const Key &a, const Key &b) const
+        {
+            return a.hash == b.hash && a.name == b.name;
+        }
+    };
+
+    // Keys view the name held here, so entries must not move.
+    struct Entry {
+        string name;
+        shared_ptr<const FileBlob> file;
+    };
+
+    struct Shard {
+        mutable shared_mutex lock;
+        unordered_map<Key, unique_ptr<Entry>, KeyHash, KeyEqual> entries;
+        size_t bytes = 0;
+
+        mutable atomic<long long> reads{0};
+        atomic<long long> writes{0};
+        mutable atomic<long long> contended{0};
+    };
+
+    vector<unique_ptr<Shard>> shards;
+
+    Shard &shard_for(size_t hash) const;
+
+public:
+    explicit FileStore(size_t shard_count);
+
+    static size_t hash_name(string_view name);
+
+    void put(string_view name, shared_ptr<const FileBlob> file);
+    shared_ptr<const FileBlob> get(string_view name) const;
+
+    size_t shard_count() const { return shards.size(); }
+    StoreStats stats() const;
+};
+
+#endif
@@ -84,8 +84,9 @@ bool HealthChecker::send_health_check(BackendServer &backend, double &rtt_ms)
         return false;
     }
 
+    ConnectionReader reader(sock, 256);
     string response;
-    if (!recv_line(sock, response))
+    if (!recv_line(reader, response))
     {
         close(sock);
         return false;
@@ -106,23 +107,22 @@ void HealthChecker::update_backend_health(BackendServer &backend, bool success,
     if (success)
     {
         backend.consecutive_failures = 0;
-        backend.healthy = true;
+        backend.healthy.store(true, memory_order_relaxed);
 
-        if (backend.avg_rtt_ms == 0.0)
-        {
-            backend.avg_rtt_ms = rtt_ms;
-        }
-        else
-        {
-            backend.avg_rtt_ms = RTT_ALPHA * rtt_ms + (1.0 - RTT_ALPHA) * backend.avg_rtt_ms;
-        }
+        double avg = backend.rtt_ms();
+        avg = (avg == 0.0) ? rtt_ms : RTT_ALPHA * rtt_ms + (1.0 - RTT_ALPHA) * avg;
+        backend.avg_rtt_ms.store(avg, memory_order_relaxed);
     }
     else
     {
         backend.consecutive_failures++;
-        if (backend.consecutive_failures >= MAX_CONSECUTIVE_FAILURES)
+        if (backend.consecutive_failures >= MAX_CONSECUTIVE_FAILURES && backend.is_healthy())
         {
-            backend.healthy = false;
+            backend.healthy.store(false, memory_order_relaxed);
+            if (on_backend_down)
+            {
+                on_backend_down(backend);
+            }
         }
     }
 }
@@ -187,6 +187,11 @@ void HealthChecker::run()
     cout << "[HealthChecker] Stopped" << endl;
 }
 
+void HealthChecker::set_down_callback(function<void(BackendServer &)> callback)
+{
+    on_backend_down = callback;
+}
+
 void HealthChecker::start()
 {
     run();
@@ -6,6 +6,7 @@
 #include <fstream>
 #include <mutex>
 #include <atomic>
+#include <functional>
 
 using namespace std;
 
@@ -15,6 +16,7 @@ private:
     atomic<bool>& shutdown;
     ofstream log_file;
     mutex log_mutex;
+    function<void(BackendServer &)> on_backend_down;
     
     const int HEALTH_TIMEOUT_MS = 1000;
     const int MAX_CONSECUTIVE_FAILURES = 3;
@@ -28,6 +30,8 @@ public:
     HealthChecker(vector<BackendServer>& backend_list, atomic<bool>& shutdown_flag);
     ~HealthChecker();
     
+    void set_down_callback(function<void(BackendServer &)> callback);
+
     void start();
     void run();
 };
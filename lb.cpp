@@ -1,6 +1,10 @@
 #include "lb_config.h"
 #include "lb_algorithm.h"
 #include "health_check.h"
+#include "lb_reactor.h"
+#include "backend_pool.h"
+#include "replica_directory.h"
+#include "request_hedger.h"
 #include "protocol.h"
 #include "utils.h"
 #include <iostream>
@@ -15,7 +19,16 @@
 #include <cstring>
 #include <fstream>
 #include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <optional>
+#include <cmath>
+#include <poll.h>
 #include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <cerrno>
+#include <stdexcept>
 
 using namespace std;
 
@@ -25,19 +38,44 @@ int global_lb_sock = -1;
 ofstream lb_metrics_file;
 mutex metrics_mutex;
 
+unique_ptr<BackendPool> backend_pool;
+bool stream_relay = false;
+
+// With --replicas R > 1, PUTs are written to R backends and acknowledged
+// once write_quorum of them have stored the file.
+size_t replication_factor = 1;
+size_t write_quorum = 1;
+unique_ptr<ReplicaDirectory> replica_directory;
+
+// Set by --hedge-delay; thread-mode GETs are hedged only when present.
+unique_ptr<RequestHedger> hedger;
+
+// Thread mode detaches one thread per client. The acceptor waits for them
+// to finish on shutdown, before main() frees what they use.
+atomic<int> active_clients(0);
+const int CLIENT_DRAIN_TIMEOUT_MS = 5000;
+
+struct ActiveClient {
+    ~ActiveClient() { active_clients.fetch_sub(1); }
+};
+
 void signal_handler(int signum)
 {
     cout << "\n[LB] Received signal " << signum << ", shutting down..." << endl;
     shutdown_requested = true;
 
+    // shutdown() wakes a blocked accept(); main() closes the socket once
+    // the threads using it have exited.
+    int saved_errno = errno;
     if (global_lb_sock >= 0)
     {
         shutdown(global_lb_sock, SHUT_RDWR);
-        close(global_lb_sock);
     }
+    errno = saved_errno;
 }
 
-void log_request(const string &request_type, int backend_id, double response_time_ms)
+void log_request(const string &request_type, int backend_id, double response_time_ms,
+                 size_t file_size)
 {
     lock_guard<mutex> lock(metrics_mutex);
 
@@ -54,68 +92,115 @@ void log_request(const string &request_type, int backend_id, double response_tim
     lb_metrics_file << timestamp_ms << ","
                     << request_type << ","
                     << backend_id << ","
-                    << response_time_ms << "\n";
+                    << response_time_ms << ","
+                    << file_size << "\n";
     lb_metrics_file.flush();
 }
 
-int connect_to_backend(const BackendServer &backend)
+bool send_request_header(int backend_sock, const Request &request, bool keep_alive)
 {
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0)
+    string header;
+    if (keep_alive)
     {
-        return -1;
+        header += PROTOCOL_KEEPALIVE + "\n";
+    }
+    if (request.deadline_ms > 0)
+    {
+        header += PROTOCOL_DEADLINE + " " + to_string(request.deadline_ms) + "\n";
+    }
+    if (!request.client_key.empty())
+    {
+        header += PROTOCOL_CLIENT + " " + request.client_key + "\n";
+    }
+    if (request.type == RequestType::PUT)
+    {
+        header += PROTOCOL_PUT + " " + request.filename + "\n";
+        header += PROTOCOL_SIZE + " " + to_string(request.file_size) + "\n";
+    }
+    else
+    {
+        header += PROTOCOL_GET + " " + request.filename + "\n";
     }
 
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(backend.port);
-    inet_pton(AF_INET, backend.ip.c_str(), &server_addr.sin_addr);
+    ssize_t total_sent = 0;
+    ssize_t len = header.length();
+    while (total_sent < len)
+    {
+        ssize_t sent = send(backend_sock, header.c_str() + total_sent, len - total_sent, MSG_NOSIGNAL);
+        if (sent <= 0)
+        {
+            return false;
+        }
+        total_sent += sent;
+    }
+    return true;
+}
 
-    if (connect(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) < 0)
+bool forward_put_request(int client_sock, int backend_sock, const Request &request,
+                         bool keep_alive)
+{
+    if (!send_request_header(backend_sock, request, keep_alive))
     {
-        close(sock);
-        return -1;
+        return false;
     }
 
-    return sock;
+    if (!send_file(backend_sock, *request.file_data))
+    {
+        return false;
+    }
+
+    ConnectionReader backend_reader(backend_sock);
+    string response;
+    if (!recv_line(backend_reader, response))
+    {
+        return false;
+    }
+
+    return send_line(client_sock, response) && response == PROTOCOL_OK;
 }
 
-bool forward_put_request(int client_sock, int backend_sock, const Request &request)
+// Relays the SIZE line and body of a GET whose OK status line has already
+// been read from the backend and sent to the client.
+bool relay_get_response(int client_sock, ConnectionReader &backend_reader, Request &request)
 {
-    if (!send_line(backend_sock, PROTOCOL_PUT + " " + request.filename))
+    string size_line;
+    if (!recv_line(backend_reader, size_line))
     {
         return false;
     }
 
-    if (!send_line(backend_sock, PROTOCOL_SIZE + " " + to_string(request.file_size)))
+    if (!send_line(client_sock, size_line))
     {
         return false;
     }
 
-    if (!send_file(backend_sock, request.file_lines, 10))
+    size_t file_size = 0;
+    if (!parse_size_line(size_line, file_size))
     {
         return false;
     }
+    request.file_size = file_size;
 
-    string response;
-    if (!recv_line(backend_sock, response))
+    FileBlob file;
+    if (!recv_file(backend_reader, file_size, file))
     {
         return false;
     }
 
-    return send_line(client_sock, response);
+    return send_file(client_sock, file);
 }
 
-bool forward_get_request(int client_sock, int backend_sock, const Request &request)
+bool forward_get_request(int client_sock, int backend_sock, Request &request,
+                         bool keep_alive)
 {
-    if (!send_line(backend_sock, PROTOCOL_GET + " " + request.filename))
+    if (!send_request_header(backend_sock, request, keep_alive))
     {
         return false;
     }
 
+    ConnectionReader backend_reader(backend_sock);
     string response;
-    if (!recv_line(backend_sock, response))
+    if (!recv_line(backend_reader, response))
     {
         return false;
     }
@@ -130,47 +215,507 @@ bool forward_get_request(int client_sock, int backend_sock, const Request &reque
         return false;
     }
 
+    return relay_get_response(client_sock, backend_reader, request);
+}
+
+bool stream_put_request(ConnectionReader &client_reader, int backend_sock,
+                        const Request &request, bool keep_alive)
+{
+    int client_sock = client_reader.fd();
+    if (!send_request_header(backend_sock, request, keep_alive))
+    {
+        return false;
+    }
+
+    if (!relay_bytes(client_reader, backend_sock, request.file_size + PROTOCOL_END.size() + 1))
+    {
+        return false;
+    }
+
+    ConnectionReader backend_reader(backend_sock);
+    string response;
+    if (!recv_line(backend_reader, response))
+    {
+        return false;
+    }
+
+    return send_line(client_sock, response) && response == PROTOCOL_OK;
+}
+
+// Streams the SIZE line and body of a GET whose OK status line has already
+// been read from the backend and sent to the client.
+bool stream_get_response(int client_sock, ConnectionReader &backend_reader, Request &request)
+{
     string size_line;
-    if (!recv_line(backend_sock, size_line))
+    if (!recv_line(backend_reader, size_line) || !send_line(client_sock, size_line))
     {
         return false;
     }
 
-    if (!send_line(client_sock, size_line))
+    size_t file_size = 0;
+    if (!parse_size_line(size_line, file_size))
+    {
+        return false;
+    }
+    request.file_size = file_size;
+
+    return relay_bytes(backend_reader, client_sock, file_size + PROTOCOL_END.size() + 1);
+}
+
+bool stream_get_request(int client_sock, int backend_sock, Request &request,
+                        bool keep_alive)
+{
+    if (!send_request_header(backend_sock, request, keep_alive))
+    {
+        return false;
+    }
+
+    ConnectionReader backend_reader(backend_sock);
+    string response;
+    if (!recv_line(backend_reader, response))
+    {
+        return false;
+    }
+
+    if (!send_line(client_sock, response) || response != PROTOCOL_OK)
+    {
+        return false;
+    }
+
+    return stream_get_response(client_sock, backend_reader, request);
+}
+
+struct WriteQuorum {
+    mutex lock;
+    condition_variable done;
+    size_t acks = 0;
+    size_t failures = 0;
+};
+
+bool put_to_backend(BackendServer &backend, const Request &request)
+{
+    InFlightGuard in_flight(backend);
+    int backend_sock = backend_pool ? backend_pool->acquire(backend)
+                                    : connect_to_backend(backend);
+    if (backend_sock < 0)
+    {
+        return false;
+    }
+
+    bool keep_alive = (backend_pool != nullptr);
+    bool success = false;
+    if (send_request_header(backend_sock, request, keep_alive) &&
+        send_file(backend_sock, *request.file_data))
+    {
+        ConnectionReader backend_reader(backend_sock);
+        string response;
+        success = recv_line(backend_reader, response) && response == PROTOCOL_OK;
+    }
+
+    if (backend_pool)
+    {
+        backend_pool->release(backend, backend_sock, success);
+    }
+    else
+    {
+        close(backend_sock);
+    }
+    return success;
+}
+
+// Writes the file to the backends the algorithm places its copies on, or
+// else the primary and the next healthy backends, in parallel and returns
+// once write_quorum have stored it, or once that can no longer
+// happen. GETs read the file's previous replicas until the quorum is
+// reached. Stragglers finish in the background and still join the replica
+// set unless a newer PUT of the file has been committed or this one missed
+// its quorum; each holds an ActiveClient so shutdown waits for them.
+bool replicate_put(const Request &request, BackendServer *primary, LBAlgorithm &lb_algo,
+                   vector<BackendServer> &backends)
+{
+    vector<BackendServer *> replicas = lb_algo.place_copies(request.filename, replication_factor);
+    if (replicas.empty())
+    {
+        replicas = choose_replicas(backends, primary, replication_factor);
+    }
+    ReplicationStats &stats = replica_directory->get_stats();
+    stats.writes.fetch_add(1);
+    unsigned long long generation = replica_directory->start_write(request.filename);
+
+    auto quorum = make_shared<WriteQuorum>();
+    for (BackendServer *replica : replicas)
+    {
+        active_clients.fetch_add(1);
+        thread writer([quorum, request, replica, generation]()
+                      {
+            ActiveClient active;
+            bool stored = put_to_backend(*replica, request);
+            if (stored)
+            {
+                replica_directory->add(request.filename, replica, generation);
+            }
+            else
+            {
+                replica_directory->get_stats().replica_failures.fetch_add(1);
+            }
+            lock_guard<mutex> lock(quorum->lock);
+            ++(stored ? quorum->acks : quorum->failures);
+            quorum->done.notify_all(); });
+        writer.detach();
+    }
+
+    unique_lock<mutex> lock(quorum->lock);
+    quorum->done.wait(lock, [&]()
+                      { return quorum->acks >= write_quorum ||
+                               quorum->acks + quorum->failures == replicas.size(); });
+    if (quorum->acks < write_quorum)
+    {
+        stats.quorum_failures.fetch_add(1);
+        replica_directory->abandon(request.filename, generation);
+        return false;
+    }
+    replica_directory->commit(request.filename, generation);
+    return true;
+}
+
+// One backend connection racing to answer a hedged GET.
+struct HedgeLeg {
+    BackendServer *backend;
+    int sock;
+    ConnectionReader reader;
+    string response;
+
+    HedgeLeg(BackendServer *server, int fd) : backend(server), sock(fd), reader(fd) {}
+};
+
+void drop_backend_connection(BackendServer &backend, int backend_sock)
+{
+    if (backend_pool)
     {
+        backend_pool->release(backend, backend_sock, false);
+    }
+    else
+    {
+        close(backend_sock);
+    }
+}
+
+// The least-loaded healthy candidate other than the primary, or null.
+BackendServer *hedge_target(const vector<BackendServer *> &candidates, const BackendServer *primary)
+{
+    BackendServer *target = nullptr;
+    for (BackendServer *candidate : candidates)
+    {
+        if (candidate != primary && candidate->is_healthy() &&
+            (!target || candidate->outstanding() < target->outstanding()))
+        {
+            target = candidate;
+        }
+    }
+    return target;
+}
+
+// Backends a GET with no replica entry may be hedged to: none when the
+// algorithm knows the one backend holding the file (chash, or sita for a
+// file it has placed), otherwise any backend might have it.
+vector<BackendServer *> hedge_candidates(LBAlgorithm &lb_algo, vector<BackendServer> &backends,
+                                         const string &filename)
+{
+    vector<BackendServer *> candidates;
+    if (!lb_algo.holder_known(filename))
+    {
+        for (auto &backend : backends)
+        {
+            candidates.push_back(&backend);
+        }
+    }
+    return candidates;
+}
+
+// Sends the GET and, if its status line has not arrived within the hedge
+// delay and the budget allows, a duplicate to the least-loaded of the
+// candidates. The first OK answer is relayed to the client; the other
+// connection is closed, which cancels it. On return backend, backend_sock
+// and in_flight refer to the backend whose answer was used, and response
+// holds its status line (empty if neither answered). A status other than
+// OK is left for the caller to relay or fail over on.
+bool hedged_get_request(int client_sock, const vector<BackendServer *> &candidates,
+                        BackendServer *&backend, int &backend_sock,
+                        optional<InFlightGuard> &in_flight, Request &request, bool keep_alive,
+                        string &response)
+{
+    response.clear();
+    hedger->on_request();
+    if (!send_request_header(backend_sock, request, keep_alive))
+    {
+        return false;
+    }
+    auto sent = chrono::steady_clock::now();
+
+    vector<HedgeLeg> legs;
+    legs.reserve(2);
+    legs.emplace_back(backend, backend_sock);
+
+    optional<InFlightGuard> hedge_in_flight;
+    double delay = hedger->delay_ms();
+    struct pollfd primary = {backend_sock, POLLIN, 0};
+    if (delay >= 0 && poll(&primary, 1, static_cast<int>(ceil(delay))) == 0)
+    {
+        BackendServer *second = hedge_target(candidates, backend);
+        if (second && hedger->try_spend())
+        {
+            hedge_in_flight.emplace(*second);
+            int second_sock = backend_pool ? backend_pool->acquire(*second)
+                                           : connect_to_backend(*second);
+            if (second_sock >= 0 && send_request_header(second_sock, request, keep_alive))
+            {
+                cout << "[LB] Backend " << backend->id << " slow after " << delay
+                     << " ms, hedging GET to backend " << second->id << endl;
+                legs.emplace_back(second, second_sock);
+            }
+            else if (second_sock >= 0)
+            {
+                drop_backend_connection(*second, second_sock);
+            }
+        }
+    }
+
+    // Take the first OK; an ERROR from one leg waits for the other.
+    size_t chosen = legs.size();
+    vector<bool> answered(legs.size(), false);
+    size_t waiting = legs.size();
+    bool found = false;
+    while (!found && waiting > 0)
+    {
+        struct pollfd fds[2];
+        for (size_t i = 0; i < legs.size(); ++i)
+        {
+            fds[i] = {answered[i] ? -1 : legs[i].sock, POLLIN, 0};
+        }
+        if (poll(fds, legs.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+        for (size_t i = 0; i < legs.size() && !found; ++i)
+        {
+            if (answered[i] || fds[i].revents == 0)
+            {
+                continue;
+            }
+            answered[i] = true;
+            --waiting;
+            if (recv_line(legs[i].reader, legs[i].response))
+            {
+                chosen = i;
+                found = (legs[i].response == PROTOCOL_OK);
+            }
+        }
+    }
+
+    if (chosen == legs.size())
+    {
+        if (legs.size() > 1)
+        {
+            drop_backend_connection(*legs[1].backend, legs[1].sock);
+        }
         return false;
     }
 
-    size_t file_size;
-    sscanf(size_line.c_str(), "SIZE %zu", &file_size);
+    if (found)
+    {
+        hedger->record_response_ms(chrono::duration<double, milli>(
+                                       chrono::steady_clock::now() - sent)
+                                       .count());
+    }
+
+    if (chosen == 1)
+    {
+        if (found)
+        {
+            hedger->get_stats().hedge_wins.fetch_add(1, memory_order_relaxed);
+            cout << "[LB] Hedged GET answered first by backend " << legs[1].backend->id << endl;
+        }
+        drop_backend_connection(*backend, backend_sock);
+        backend = legs[1].backend;
+        backend_sock = legs[1].sock;
+        in_flight.emplace(*backend);
+    }
+    else if (legs.size() > 1)
+    {
+        drop_backend_connection(*legs[1].backend, legs[1].sock);
+    }
+    hedge_in_flight.reset();
 
-    vector<string> lines;
-    if (!recv_file(backend_sock, file_size, lines))
+    HedgeLeg &winner = legs[chosen];
+    response = winner.response;
+    if (!found || !send_line(client_sock, winner.response))
     {
         return false;
     }
+    return stream_relay ? stream_get_response(client_sock, winner.reader, request)
+                        : relay_get_response(client_sock, winner.reader, request);
+}
+
+// Serves a GET from the least-loaded live replica, moving on to the next
+// one if a backend cannot be reached or no longer has the file. With
+// --hedge-delay a slow replica is hedged to the least-loaded replica not
+// yet tried. Returns the replica that served it, or the last one tried.
+BackendServer *read_from_replicas(int client_sock, vector<BackendServer *> replicas,
+                                  Request &request, bool &success)
+{
+    ReplicationStats &stats = replica_directory->get_stats();
+    stats.replicated_reads.fetch_add(1);
 
-    return send_file(client_sock, lines, 10);
+    for (size_t i = replicas.size(); i > 1; --i)
+    {
+        swap(replicas[i - 1], replicas[random_index(i)]);
+    }
+    stable_sort(replicas.begin(), replicas.end(), [](BackendServer *a, BackendServer *b)
+                { return a->outstanding() < b->outstanding(); });
+
+    bool keep_alive = (backend_pool != nullptr);
+    BackendServer *tried = nullptr;
+    success = false;
+    for (size_t i = 0; i < replicas.size(); ++i)
+    {
+        BackendServer *replica = replicas[i];
+        if (tried)
+        {
+            stats.read_failovers.fetch_add(1);
+            cout << "[LB] Replica " << tried->id << " failed, trying backend " << replica->id << endl;
+        }
+        tried = replica;
+
+        optional<InFlightGuard> in_flight;
+        in_flight.emplace(*replica);
+        auto forward_start = chrono::steady_clock::now();
+        int backend_sock = backend_pool ? backend_pool->acquire(*replica)
+                                        : connect_to_backend(*replica);
+        if (backend_sock < 0)
+        {
+            continue;
+        }
+
+        string response;
+        if (hedger)
+        {
+            vector<BackendServer *> untried(replicas.begin() + i + 1, replicas.end());
+            success = hedged_get_request(client_sock, untried, replica, backend_sock, in_flight,
+                                         request, keep_alive, response);
+            tried = replica;
+        }
+        else
+        {
+            ConnectionReader backend_reader(backend_sock);
+            if (!send_request_header(backend_sock, request, keep_alive) ||
+                !recv_line(backend_reader, response))
+            {
+                response.clear();
+            }
+            else if (response == PROTOCOL_OK)
+            {
+                success = send_line(client_sock, response) &&
+                          relay_get_response(client_sock, backend_reader, request);
+            }
+        }
+
+        if (success)
+        {
+            record_latency(*replica, chrono::duration<double, milli>(
+                                         chrono::steady_clock::now() - forward_start)
+                                         .count());
+        }
+        else if (!response.empty() && response != PROTOCOL_OK)
+        {
+            replica_directory->remove(request.filename, replica);
+        }
+
+        if (backend_pool)
+        {
+            backend_pool->release(*replica, backend_sock, success);
+        }
+        else
+        {
+            close(backend_sock);
+        }
+
+        if (response == PROTOCOL_OK)
+        {
+            return replica;
+        }
+    }
+
+    send_line(client_sock, PROTOCOL_ERROR + " No replica available");
+    return tried;
 }
 
-void handle_client(int client_sock, LBAlgorithm *lb_algo, LBConfig)
+// Balancer is the concrete Balancer<Algo>, so select_backend() binds
+// statically; start_acceptor() picks the instantiation once at startup.
+template <typename Balancer>
+void handle_client(int client_sock, Balancer *lb_algo, LBConfig &config)
 {
+    ActiveClient active;
     auto request_start = chrono::steady_clock::now();
 
+    ConnectionReader client_reader(client_sock);
     Request request;
-    if (!parse_request(client_sock, request))
+    bool parsed = stream_relay ? parse_request_header(client_reader, request)
+                               : parse_request(client_reader, request);
+    if (!parsed)
     {
         cerr << "[LB] Failed to parse client request" << endl;
         send_line(client_sock, PROTOCOL_ERROR + " Malformed request");
         close(client_sock);
         return;
     }
+    if (request.client_key.empty())
+    {
+        request.client_key = peer_address(client_sock);
+    }
 
     cout << "[LB] Received "
          << (request.type == RequestType::PUT ? "PUT" : "GET")
          << " request for " << request.filename << endl;
 
-    BackendServer *backend = lb_algo->select_backend();
+    vector<BackendServer *> replicas;
+    if (replica_directory && request.type == RequestType::GET)
+    {
+        for (BackendServer *replica : replica_directory->lookup(request.filename))
+        {
+            if (replica->is_healthy())
+            {
+                replicas.push_back(replica);
+            }
+        }
+    }
+    if (!replicas.empty())
+    {
+        bool success = false;
+        BackendServer *served = read_from_replicas(client_sock, replicas, request, success);
+        double response_time_ms = chrono::duration<double, milli>(
+                                      chrono::steady_clock::now() - request_start)
+                                      .count();
+        log_request("GET", served->id, response_time_ms, request.file_size);
+        if (success)
+        {
+            lb_algo->record_size(request.filename, request.file_size, *served);
+            cout << "[LB] Served GET from replica " << served->id
+                 << " (took " << response_time_ms << " ms)" << endl;
+        }
+        else
+        {
+            cerr << "[LB] Failed to forward GET request" << endl;
+        }
+        close(client_sock);
+        return;
+    }
+
+    BackendServer *backend = lb_algo->select_backend(request.filename, request.type,
+                                                      request.type == RequestType::PUT ? request.file_size : 0);
     if (!backend)
     {
         cerr << "[LB] No backend available" << endl;
@@ -179,10 +724,37 @@ void handle_client(int client_sock, LBAlgorithm *lb_algo, LBConfig)
         return;
     }
 
+    if (replica_directory && request.type == RequestType::PUT)
+    {
+        bool success = replicate_put(request, backend, *lb_algo, config.backends);
+        send_line(client_sock, success ? PROTOCOL_OK : PROTOCOL_ERROR + " Write quorum not reached");
+        double response_time_ms = chrono::duration<double, milli>(
+                                      chrono::steady_clock::now() - request_start)
+                                      .count();
+        log_request("PUT", backend->id, response_time_ms, request.file_size);
+        if (success)
+        {
+            lb_algo->record_size(request.filename, request.file_size, *backend);
+            cout << "[LB] Replicated PUT from backend " << backend->id
+                 << " (took " << response_time_ms << " ms)" << endl;
+        }
+        else
+        {
+            cerr << "[LB] Write quorum not reached for " << request.filename << endl;
+        }
+        close(client_sock);
+        return;
+    }
+
+    optional<InFlightGuard> in_flight;
+    in_flight.emplace(*backend);
+    auto forward_start = chrono::steady_clock::now();
+
     cout << "[LB] Selected backend " << backend->id
          << " (" << backend->ip << ":" << backend->port << ")" << endl;
 
-    int backend_sock = connect_to_backend(*backend);
+    int backend_sock = backend_pool ? backend_pool->acquire(*backend)
+                                    : connect_to_backend(*backend);
     if (backend_sock < 0)
     {
         cerr << "[LB] Failed to connect to backend " << backend->id << endl;
@@ -191,24 +763,41 @@ void handle_client(int client_sock, LBAlgorithm *lb_algo, LBConfig)
         return;
     }
 
+    bool keep_alive = (backend_pool != nullptr);
     bool success = false;
     if (request.type == RequestType::PUT)
     {
-        success = forward_put_request(client_sock, backend_sock, request);
+        success = stream_relay ? stream_put_request(client_reader, backend_sock, request, keep_alive)
+                               : forward_put_request(client_sock, backend_sock, request, keep_alive);
+    }
+    else if (request.type == RequestType::GET && hedger)
+    {
+        string response;
+        success = hedged_get_request(client_sock,
+                                     hedge_candidates(*lb_algo, config.backends, request.filename),
+                                     backend, backend_sock, in_flight, request, keep_alive,
+                                     response);
+        if (!response.empty() && response != PROTOCOL_OK)
+        {
+            send_line(client_sock, response);
+        }
     }
     else if (request.type == RequestType::GET)
     {
-        success = forward_get_request(client_sock, backend_sock, request);
+        success = stream_relay ? stream_get_request(client_sock, backend_sock, request, keep_alive)
+                               : forward_get_request(client_sock, backend_sock, request, keep_alive);
     }
 
     auto request_end = chrono::steady_clock::now();
     double response_time_ms = chrono::duration<double, milli>(request_end - request_start).count();
 
     string req_type = (request.type == RequestType::PUT ? "PUT" : "GET");
-    log_request(req_type, backend->id, response_time_ms);
+    log_request(req_type, backend->id, response_time_ms, request.file_size);
 
     if (success)
     {
+        lb_algo->record_size(request.filename, request.file_size, *backend);
+        record_latency(*backend, chrono::duration<double, milli>(request_end - forward_start).count());
         cout << "[LB] Successfully forwarded " << req_type
              << " request (took " << response_time_ms << " ms)" << endl;
     }
@@ -217,11 +806,19 @@ void handle_client(int client_sock, LBAlgorithm *lb_algo, LBConfig)
         cerr << "[LB] Failed to forward " << req_type << " request" << endl;
     }
 
-    close(backend_sock);
+    if (backend_pool)
+    {
+        backend_pool->release(*backend, backend_sock, success);
+    }
+    else
+    {
+        close(backend_sock);
+    }
     close(client_sock);
 }
 
-void acceptor_thread(int lb_sock, LBAlgorithm *lb_algo, LBConfig &config)
+template <typename Balancer>
+void acceptor_thread(int lb_sock, Balancer *lb_algo, LBConfig &config)
 {
     cout << "[LB] Acceptor thread started" << endl;
 
@@ -245,19 +842,166 @@ void acceptor_thread(int lb_sock, LBAlgorithm *lb_algo, LBConfig &config)
         cout << "[LB] Accepted connection from "
              << inet_ntoa(client_addr.sin_addr) << endl;
 
-        thread client_thread(handle_client, client_sock, lb_algo, ref(config));
+        active_clients.fetch_add(1);
+        thread client_thread(handle_client<Balancer>, client_sock, lb_algo, ref(config));
         client_thread.detach();
     }
 
+    for (int waited = 0; active_clients.load() > 0 && waited < CLIENT_DRAIN_TIMEOUT_MS; waited += 10)
+    {
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+    if (active_clients.load() > 0)
+    {
+        cerr << "[LB] " << active_clients.load() << " client threads still running" << endl;
+    }
+
     cout << "[LB] Acceptor thread exiting" << endl;
 }
 
+template <typename Balancer>
+bool start_acceptor_as(int lb_sock, LBAlgorithm *lb_algo, LBConfig &config,
+                       vector<thread> &threads)
+{
+    auto *concrete = dynamic_cast<Balancer *>(lb_algo);
+    if (!concrete)
+    {
+        return false;
+    }
+    threads.emplace_back(acceptor_thread<Balancer>, lb_sock, concrete, ref(config));
+    return true;
+}
+
+void start_acceptor(int lb_sock, LBAlgorithm *lb_algo, LBConfig &config,
+                    vector<thread> &threads)
+{
+    bool started =
+        start_acceptor_as<RoundRobinLB>(lb_sock, lb_algo, config, threads) ||
+        start_acceptor_as<LeastResponseTimeLB>(lb_sock, lb_algo, config, threads) ||
+        start_acceptor_as<LeastConnectionsLB>(lb_sock, lb_algo, config, threads) ||
+        start_acceptor_as<WeightedLeastOutstandingLB>(lb_sock, lb_algo, config, threads) ||
+        start_acceptor_as<PowerOfTwoChoicesLB>(lb_sock, lb_algo, config, threads) ||
+        start_acceptor_as<PeakEWMALB>(lb_sock, lb_algo, config, threads) ||
+        start_acceptor_as<ConsistentHashLB>(lb_sock, lb_algo, config, threads) ||
+        start_acceptor_as<SizeIntervalLB>(lb_sock, lb_algo, config, threads);
+    if (!started)
+    {
+        throw runtime_error("No acceptor for this algorithm");
+    }
+}
+
+int open_listener(const LBConfig &config, bool reuse_port)
+{
+    int lb_sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (lb_sock < 0)
+    {
+        cerr << "Error: Cannot create socket" << endl;
+        return -1;
+    }
+
+    int opt_val = 1;
+    setsockopt(lb_sock, SOL_SOCKET, SO_REUSEADDR, &opt_val, sizeof(opt_val));
+    if (reuse_port && setsockopt(lb_sock, SOL_SOCKET, SO_REUSEPORT, &opt_val, sizeof(opt_val)) < 0)
+    {
+        cerr << "Error: SO_REUSEPORT not supported" << endl;
+        close(lb_sock);
+        return -1;
+    }
+
+    struct sockaddr_in lb_addr;
+    memset(&lb_addr, 0, sizeof(lb_addr));
+    lb_addr.sin_family = AF_INET;
+    lb_addr.sin_port = htons(config.lb_port);
+    inet_pton(AF_INET, config.lb_ip.c_str(), &lb_addr.sin_addr);
+
+    if (::bind(lb_sock, (struct sockaddr *)&lb_addr, sizeof(lb_addr)) < 0)
+    {
+        cerr << "Error: Cannot bind socket" << endl;
+        close(lb_sock);
+        return -1;
+    }
+
+    if (listen(lb_sock, reuse_port ? 1024 : 100) < 0)
+    {
+        cerr << "Error: Cannot listen on socket" << endl;
+        close(lb_sock);
+        return -1;
+    }
+
+    return lb_sock;
+}
+
+void pin_current_thread(int cpu)
+{
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset) != 0)
+    {
+        cerr << "[LB] Failed to pin event loop to CPU " << cpu << endl;
+    }
+}
+
+void event_loop_thread(int listen_sock, LBAlgorithm *lb_algo, int cpu)
+{
+    if (cpu >= 0)
+    {
+        pin_current_thread(cpu);
+    }
+
+    try
+    {
+        LBReactor reactor(listen_sock, lb_algo, backend_pool.get(), shutdown_requested,
+                          log_request);
+        reactor.run();
+    }
+    catch (const exception &e)
+    {
+        cerr << "[LB] Event loop failed: " << e.what() << endl;
+        shutdown_requested = true;
+    }
+}
+
 void print_usage(const char *prog_name)
 {
     cout << "Usage: " << prog_name << " [options]\n"
          << "Options:\n"
-         << "  --algo <algorithm>    Load balancing algorithm (rr or lrt) [required]\n"
+         << "  --algo <algorithm>    Load balancing algorithm [required]:\n"
+         << "                          rr   round robin\n"
+         << "                          lrt  least health-probe RTT\n"
+         << "                          lc   least in-flight requests\n"
+         << "                          wlo  least in-flight requests per unit of\n"
+         << "                               serverN_weight from the config file\n"
+         << "                          p2c  fewer in-flight of two random backends\n"
+         << "                          peak_ewma  lower request-latency EWMA x\n"
+         << "                               (in-flight + 1) of two random backends\n"
+         << "                          chash  Maglev hash of the filename; with\n"
+         << "                               --replicas, hot GETs spill to the copies\n"
+         << "                               (thread mode only)\n"
+         << "                          sita  size classes, one per backend, with\n"
+         << "                               cutoffs that split recent bytes evenly\n"
          << "  --config <path>       Config file path (default: config_lb.json)\n"
+         << "  --mode <mode>         Connection handling (default: thread):\n"
+         << "                          thread   one thread per client\n"
+         << "                          reactor  epoll event loops sharing one listener\n"
+         << "                          sharded  event loops with their own SO_REUSEPORT\n"
+         << "                                   listener and algorithm state\n"
+         << "  --loops <N>           Event loop threads in reactor/sharded mode (default: CPU count)\n"
+         << "  --pin                 Pin event loop i to CPU i\n"
+         << "  --relay <mode>        Thread mode payload handling: copy (buffer the whole\n"
+         << "                        file) or stream (splice bytes as they arrive) (default: copy)\n"
+         << "  --pool-max <N>        Keep up to N idle keep-alive connections per backend\n"
+         << "                        (default: 0, pooling disabled)\n"
+         << "  --pool-min <N>        Pre-connect N idle connections per healthy backend (default: 0)\n"
+         << "  --pool-idle-ms <ms>   Close pooled connections idle longer than this (default: 30000)\n"
+         << "  --replicas <R>        Write each PUT to R backends and spread GETs for it\n"
+         << "                        across the live copies (thread mode, copy relay; default: 1)\n"
+         << "  --write-quorum <W>    Acknowledge a replicated PUT once W backends stored it\n"
+         << "                        (default: majority of R)\n"
+         << "  --hedge-delay <ms|p95> Thread mode: if a GET has no status line after this\n"
+         << "                        long, send a duplicate to a second backend and use\n"
+         << "                        whichever answers first; p95 tracks recent GETs\n"
+         << "  --hedge-budget <pct>  Hedge at most this percent of GETs (default: 5)\n"
          << "  --help                Show this help message\n";
 }
 
@@ -265,18 +1009,41 @@ int main(int argc, char *argv[])
 {
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
+    signal(SIGPIPE, SIG_IGN);
 
     string config_file = "config_lb.json";
     string algo_str;
+    string mode_str = "thread";
+    int num_loops = max(1u, thread::hardware_concurrency());
+    bool pin_loops = false;
+    int pool_min = 0;
+    int pool_max = 0;
+    int pool_idle_ms = 30000;
+    string relay_str = "copy";
+    int replicas = 1;
+    int quorum = 0;
+    string hedge_str;
+    double hedge_budget = 5.0;
 
     static struct option long_options[] = {
         {"algo", required_argument, 0, 'a'},
         {"config", required_argument, 0, 'c'},
+        {"mode", required_argument, 0, 'm'},
+        {"loops", required_argument, 0, 'l'},
+        {"pin", no_argument, 0, 'P'},
+        {"pool-min", required_argument, 0, 'n'},
+        {"pool-max", required_argument, 0, 'x'},
+        {"pool-idle-ms", required_argument, 0, 'i'},
+        {"relay", required_argument, 0, 'r'},
+        {"replicas", required_argument, 0, 'R'},
+        {"write-quorum", required_argument, 0, 'W'},
+        {"hedge-delay", required_argument, 0, 'H'},
+        {"hedge-budget", required_argument, 0, 'B'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}};
 
     int opt;
-    while ((opt = getopt_long(argc, argv, "a:c:h", long_options, nullptr)) != -1)
+    while ((opt = getopt_long(argc, argv, "a:c:m:l:Pn:x:i:r:R:W:H:B:h", long_options, nullptr)) != -1)
     {
         switch (opt)
         {
@@ -286,6 +1053,39 @@ int main(int argc, char *argv[])
         case 'c':
             config_file = optarg;
             break;
+        case 'm':
+            mode_str = optarg;
+            break;
+        case 'l':
+            num_loops = atoi(optarg);
+            break;
+        case 'P':
+            pin_loops = true;
+            break;
+        case 'n':
+            pool_min = atoi(optarg);
+            break;
+        case 'x':
+            pool_max = atoi(optarg);
+            break;
+        case 'i':
+            pool_idle_ms = atoi(optarg);
+            break;
+        case 'r':
+            relay_str = optarg;
+            break;
+        case 'R':
+            replicas = atoi(optarg);
+            break;
+        case 'W':
+            quorum = atoi(optarg);
+            break;
+        case 'H':
+            hedge_str = optarg;
+            break;
+        case 'B':
+            hedge_budget = atof(optarg);
+            break;
         case 'h':
             print_usage(argv[0]);
             return 0;
@@ -302,6 +1102,52 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    if (mode_str != "thread" && mode_str != "reactor" && mode_str != "sharded")
+    {
+        cerr << "Error: Invalid mode: " << mode_str << " (must be thread, reactor or sharded)\n";
+        return 1;
+    }
+
+    if (num_loops < 1)
+    {
+        cerr << "Error: --loops must be at least 1\n";
+        return 1;
+    }
+
+    if (relay_str != "copy" && relay_str != "stream")
+    {
+        cerr << "Error: Invalid relay mode: " << relay_str << " (must be copy or stream)\n";
+        return 1;
+    }
+    stream_relay = (relay_str == "stream");
+
+    if (!hedge_str.empty())
+    {
+        double hedge_delay_ms = (hedge_str == "p95") ? 0.0 : atof(hedge_str.c_str());
+        if (hedge_str != "p95" && hedge_delay_ms <= 0)
+        {
+            cerr << "Error: --hedge-delay must be a positive number of ms or p95\n";
+            return 1;
+        }
+        if (hedge_budget <= 0 || hedge_budget > 100)
+        {
+            cerr << "Error: --hedge-budget must be in (0, 100]\n";
+            return 1;
+        }
+        if (mode_str != "thread")
+        {
+            cerr << "Error: --hedge-delay requires --mode thread\n";
+            return 1;
+        }
+        hedger = make_unique<RequestHedger>(hedge_delay_ms, hedge_budget);
+    }
+
+    if (pool_min < 0 || pool_max < 0 || pool_idle_ms <= 0)
+    {
+        cerr << "Error: pool sizes must be non-negative and --pool-idle-ms positive\n";
+        return 1;
+    }
+
     LBConfig config;
     try
     {
@@ -313,6 +1159,28 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    if (quorum == 0)
+    {
+        quorum = replicas / 2 + 1;
+    }
+    if (replicas < 1 || replicas > static_cast<int>(config.backends.size()) ||
+        quorum < 1 || quorum > replicas)
+    {
+        cerr << "Error: need 1 <= --write-quorum <= --replicas <= number of backends\n";
+        return 1;
+    }
+    if (replicas > 1 && (mode_str != "thread" || stream_relay))
+    {
+        cerr << "Error: --replicas requires --mode thread and --relay copy\n";
+        return 1;
+    }
+    if (replicas > 1)
+    {
+        replication_factor = replicas;
+        write_quorum = quorum;
+        replica_directory = make_unique<ReplicaDirectory>();
+    }
+
     LBAlgorithmType algo_type;
     try
     {
@@ -323,19 +1191,65 @@ int main(int argc, char *argv[])
         cerr << "Error: " << e.what() << endl;
         return 1;
     }
+    // A hot chash key can only spill to backends holding a copy, and only
+    // thread mode writes copies.
+    if (algo_type == LBAlgorithmType::CONSISTENT_HASH && mode_str != "thread")
+    {
+        cerr << "Error: --algo chash requires --mode thread (hot keys spill over --replicas)\n";
+        return 1;
+    }
+
+    bool sharded = (mode_str == "sharded");
+    int num_algos = sharded ? num_loops : 1;
 
-    auto lb_algo = create_lb_algorithm(algo_type, config.backends);
+    vector<unique_ptr<LBAlgorithm>> lb_algos;
+    for (int i = 0; i < num_algos; ++i)
+    {
+        lb_algos.push_back(create_lb_algorithm(algo_type, config.backends));
+        lb_algos.back()->set_copies(replication_factor);
+    }
+    LBAlgorithm *lb_algo = lb_algos[0].get();
 
     cout << "=== Load Balancer Configuration ===\n"
          << "IP: " << config.lb_ip << "\n"
          << "Port: " << config.lb_port << "\n"
          << "Algorithm: " << lb_algo->get_name() << "\n"
-         << "Backends:\n";
+         << "Mode: " << mode_str;
+    if (mode_str != "thread")
+    {
+        cout << " (" << num_loops << " event loops" << (pin_loops ? ", pinned" : "") << ")";
+    }
+    else
+    {
+        cout << " (" << relay_str << " relay)";
+    }
+    cout << "\n";
+    if (hedger)
+    {
+        cout << "Hedging: GETs after " << (hedger->tracks_p95() ? "p95" : hedge_str + " ms")
+             << ", budget " << hedge_budget << "%\n";
+    }
+    if (replica_directory)
+    {
+        cout << "Replication: " << replication_factor << " copies, write quorum "
+             << write_quorum << "\n";
+    }
+    if (pool_max > 0)
+    {
+        cout << "Backend pool: min " << min(pool_min, pool_max) << ", max " << pool_max
+             << " idle/backend, idle timeout " << pool_idle_ms << " ms\n";
+    }
+    cout << "Backends:\n";
 
     for (const auto &backend : config.backends)
     {
         cout << "  Backend " << backend.id << ": "
-             << backend.ip << ":" << backend.port << "\n";
+             << backend.ip << ":" << backend.port;
+        if (backend.weight != 1.0)
+        {
+            cout << " (weight " << backend.weight << ")";
+        }
+        cout << "\n";
     }
     cout << "===================================\n"
          << endl;
@@ -343,60 +1257,123 @@ int main(int argc, char *argv[])
     lb_metrics_file.open("lb_metrics.log");
     if (lb_metrics_file.is_open())
     {
-        lb_metrics_file << "timestamp_ms,request_type,backend_selected,response_time_ms\n";
+        lb_metrics_file << "timestamp_ms,request_type,backend_selected,response_time_ms,file_size\n";
         lb_metrics_file.flush();
     }
 
-    int lb_sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (lb_sock < 0)
+    vector<int> listen_socks;
+    for (int i = 0; i < (sharded ? num_loops : 1); ++i)
     {
-        cerr << "Error: Cannot create socket" << endl;
-        return 1;
+        int lb_sock = open_listener(config, sharded);
+        if (lb_sock < 0)
+        {
+            for (int sock : listen_socks)
+            {
+                close(sock);
+            }
+            return 1;
+        }
+        listen_socks.push_back(lb_sock);
     }
-    global_lb_sock = lb_sock;
-
-    int opt_val = 1;
-    setsockopt(lb_sock, SOL_SOCKET, SO_REUSEADDR, &opt_val, sizeof(opt_val));
-
-    struct sockaddr_in lb_addr;
-    memset(&lb_addr, 0, sizeof(lb_addr));
-    lb_addr.sin_family = AF_INET;
-    lb_addr.sin_port = htons(config.lb_port);
-    inet_pton(AF_INET, config.lb_ip.c_str(), &lb_addr.sin_addr);
-
-    if (::bind(lb_sock, (struct sockaddr *)&lb_addr, sizeof(lb_addr)) < 0)
+    int lb_sock = listen_socks[0];
+    if (!sharded)
     {
-        cerr << "Error: Cannot bind socket" << endl;
-        close(lb_sock);
-        return 1;
+        global_lb_sock = lb_sock;
     }
 
-    if (listen(lb_sock, 100) < 0)
+    cout << "[LB] Listening on " << config.lb_ip << ":" << config.lb_port;
+    if (sharded)
     {
-        cerr << "Error: Cannot listen on socket" << endl;
-        close(lb_sock);
-        return 1;
+        cout << " (" << listen_socks.size() << " SO_REUSEPORT listeners)";
     }
+    cout << endl;
 
-    cout << "[LB] Listening on " << config.lb_ip << ":" << config.lb_port << endl;
+    thread pool_thread;
+    if (pool_max > 0)
+    {
+        backend_pool = make_unique<BackendPool>(config.backends, pool_min, pool_max, pool_idle_ms);
+        pool_thread = thread([]()
+                             { backend_pool->run_maintenance(shutdown_requested); });
+    }
 
     thread health_thread([&config]()
                          {
 HealthChecker checker(config.backends, shutdown_requested);
+        if (backend_pool)
+        {
+            checker.set_down_callback([](BackendServer &backend)
+                                      { backend_pool->purge(backend); });
+        }
         checker.start(); });
 
-    thread acceptor(acceptor_thread, lb_sock, lb_algo.get(), ref(config));
+    unsigned num_cpus = max(1u, thread::hardware_concurrency());
+    vector<thread> loop_threads;
+    if (mode_str == "thread")
+    {
+        start_acceptor(lb_sock, lb_algo, config, loop_threads);
+    }
+    else
+    {
+        for (int sock : listen_socks)
+        {
+            set_nonblocking(sock);
+        }
+
+        for (int i = 0; i < num_loops; ++i)
+        {
+            int sock = sharded ? listen_socks[i] : lb_sock;
+            LBAlgorithm *algo = sharded ? lb_algos[i].get() : lb_algo;
+            int cpu = pin_loops ? static_cast<int>(i % num_cpus) : -1;
+            loop_threads.emplace_back(event_loop_thread, sock, algo, cpu);
+        }
+    }
 
     cout << "[LB] Press Ctrl+C to stop...\n"
          << endl;
 
-    acceptor.join();
+    for (auto &t : loop_threads)
+    {
+        t.join();
+    }
     health_thread.join();
 
+    if (pool_thread.joinable())
+    {
+        pool_thread.join();
+        const PoolStats &stats = backend_pool->get_stats();
+        cout << "[LB] Backend pool: " << stats.hits << " hits, " << stats.misses << " misses, "
+             << stats.evictions << " evicted, " << stats.purged << " purged" << endl;
+        backend_pool.reset();
+    }
+
+    if (hedger)
+    {
+        HedgeStats &stats = hedger->get_stats();
+        cout << "[LB] Hedging: " << stats.requests << " GETs, " << stats.hedged << " hedged, "
+             << stats.hedge_wins << " won by the hedge, " << stats.over_budget
+             << " over budget" << endl;
+    }
+
+    if (replica_directory)
+    {
+        ReplicationStats &stats = replica_directory->get_stats();
+        cout << "[LB] Replication: " << stats.writes << " writes, " << stats.quorum_failures
+             << " below quorum, " << stats.replica_failures << " replica write failures, "
+             << stats.replicated_reads << " replica reads, " << stats.read_failovers
+             << " read failovers" << endl;
+    }
+
     if (global_lb_sock >= 0)
     {
         close(global_lb_sock);
     }
+    else
+    {
+        for (int sock : listen_socks)
+        {
+            close(sock);
+        }
+    }
 
     if (lb_metrics_file.is_open())
     {
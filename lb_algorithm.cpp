@@ -1,72 +1,290 @@
 #include "lb_algorithm.h"
+#include "utils.h"
 #include <algorithm>
-#include <limits>
+#include <cmath>
 #include <iostream>
 
 using namespace std;
 
-RoundRobinLB::RoundRobinLB(vector<BackendServer> &backend_list)
-    : LBAlgorithm(backend_list), current_index(0) {}
+void record_latency(BackendServer &backend, double latency_ms)
+{
+    long long now = get_current_time_ns();
+    long long previous = backend.latency_updated_ns.exchange(now, memory_order_relaxed);
+    double keep = previous ? exp(-ns_to_ms(now - previous) / PEAK_EWMA_DECAY_MS) : 0.0;
+
+    double current = backend.latency_ms();
+    double next;
+    do
+    {
+        next = (latency_ms >= current) ? latency_ms
+                                       : current * keep + latency_ms * (1.0 - keep);
+    } while (!backend.latency_ewma_ms.compare_exchange_weak(current, next,
+                                                            memory_order_relaxed));
+}
+
+// FNV-1a, then a murmur-style finalizer so nearby names spread out.
+static uint64_t hash_key(const string &key, uint64_t seed)
+{
+    uint64_t h = 14695981039346656037ULL ^ seed;
+    for (unsigned char c : key)
+    {
+        h ^= c;
+        h *= 1099511628211ULL;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return h;
+}
+
+shared_ptr<const MaglevTable> build_maglev_table(const vector<BackendServer> &backends)
+{
+    const size_t size = MaglevTable::SIZE;
+    auto table = make_shared<MaglevTable>();
+    table->slots.assign(size, MaglevTable::EMPTY);
+
+    // Each healthy backend walks its own permutation of the slots (offset,
+    // skip from its address) and they take turns claiming the next free
+    // slot. The permutations do not depend on the other backends, which is
+    // what keeps movement small when one of them joins or leaves.
+    vector<size_t> members, offset, skip, next;
+    for (size_t i = 0; i < backends.size(); ++i)
+    {
+        bool up = backends[i].is_healthy();
+        table->healthy.push_back(up);
+        if (!up)
+        {
+            continue;
+        }
+        string key = backends[i].ip + ":" + to_string(backends[i].port);
+        members.push_back(i);
+        offset.push_back(hash_key(key, 0) % size);
+        skip.push_back(hash_key(key, 0x9e3779b97f4a7c15ULL) % (size - 1) + 1);
+        next.push_back(0);
+    }
+
+    size_t filled = 0;
+    while (!members.empty() && filled < size)
+    {
+        for (size_t m = 0; m < members.size() && filled < size; ++m)
+        {
+            size_t slot = (offset[m] + next[m] * skip[m]) % size;
+            while (table->slots[slot] != MaglevTable::EMPTY)
+            {
+                ++next[m];
+                slot = (offset[m] + next[m] * skip[m]) % size;
+            }
+            table->slots[slot] = static_cast<uint16_t>(members[m]);
+            ++next[m];
+            ++filled;
+        }
+    }
+    return table;
+}
 
-BackendServer *RoundRobinLB::select_backend()
+shared_ptr<const MaglevTable> ConsistentHash::current_table(const vector<BackendServer> &backends)
 {
-    lock_guard<mutex> lock(selection_mutex);
+    shared_ptr<const MaglevTable> snapshot = atomic_load(&table);
+    bool stale = !snapshot || snapshot->healthy.size() != backends.size();
+    for (size_t i = 0; !stale && i < backends.size(); ++i)
+    {
+        stale = (snapshot->healthy[i] != backends[i].is_healthy());
+    }
+    if (stale)
+    {
+        // Racing rebuilds for the same health set produce the same table.
+        snapshot = build_maglev_table(backends);
+        atomic_store(&table, snapshot);
+    }
+    return snapshot;
+}
 
+BackendServer *ConsistentHash::select(vector<BackendServer> &backends, const string &filename,
+                                      RequestType type, size_t size)
+{
+    (void)size;
     if (backends.empty())
     {
         return nullptr;
     }
+    if (filename.empty())
+    {
+        return select(backends);
+    }
 
-    size_t start_index = current_index;
-    size_t attempts = 0;
-
-    while (attempts < backends.size())
+    shared_ptr<const MaglevTable> snapshot = current_table(backends);
+    size_t slot = hash_key(filename, 0) % MaglevTable::SIZE;
+    uint16_t owner = snapshot->slots[slot];
+    if (owner == MaglevTable::EMPTY)
+    {
+        return &backends[slot % backends.size()];
+    }
+    if (type != RequestType::GET || copies <= 1)
     {
-        BackendServer &backend = backends[current_index];
-        current_index = (current_index + 1) % backends.size();
+        return &backends[owner];
+    }
 
-        if (backend.healthy)
+    int total = 0;
+    int healthy = 0;
+    for (const auto &backend : backends)
+    {
+        if (backend.is_healthy())
         {
-            return &backend;
+            total += backend.outstanding();
+            ++healthy;
         }
-
-        attempts++;
     }
+    double limit = max(ceil(LOAD_FACTOR * (total + 1) / max(healthy, 1)),
+                       static_cast<double>(SPILL_FLOOR));
 
-    current_index = (start_index + 1) % backends.size();
-    return &backends[start_index];
+    // The first copy under the limit wins, which is the owner unless it is
+    // overloaded.
+    for (BackendServer *candidate : place_copies(backends, filename, copies))
+    {
+        if (candidate->outstanding() + 1 <= limit)
+        {
+            return candidate;
+        }
+    }
+    return &backends[owner];
 }
 
-LeastResponseTimeLB::LeastResponseTimeLB(vector<BackendServer> &backend_list)
-    : LBAlgorithm(backend_list) {}
+vector<BackendServer *> ConsistentHash::place_copies(vector<BackendServer> &backends,
+                                                     const string &filename, size_t count)
+{
+    vector<BackendServer *> placed;
+    if (backends.empty())
+    {
+        return placed;
+    }
+    shared_ptr<const MaglevTable> snapshot = current_table(backends);
+    size_t slot = hash_key(filename, 0) % MaglevTable::SIZE;
+    for (size_t step = 0; step < MaglevTable::SIZE && placed.size() < count; ++step)
+    {
+        uint16_t candidate = snapshot->slots[(slot + step) % MaglevTable::SIZE];
+        if (candidate != MaglevTable::EMPTY &&
+            find(placed.begin(), placed.end(), &backends[candidate]) == placed.end())
+        {
+            placed.push_back(&backends[candidate]);
+        }
+    }
+    return placed;
+}
 
-BackendServer *LeastResponseTimeLB::select_backend()
+size_t SizeInterval::size_class(const SizeProfile &profile, size_t size, size_t classes)
 {
-    lock_guard<mutex> lock(selection_mutex);
+    if (classes <= 1 || profile.total_bytes <= 0)
+    {
+        return 0;
+    }
+    size_t below = lower_bound(profile.sizes.begin(), profile.sizes.end(), size) -
+                   profile.sizes.begin();
+    size_t index = static_cast<size_t>(classes * profile.bytes_below[below] / profile.total_bytes);
+    return min(index, classes - 1);
+}
 
-    if (backends.empty())
+BackendServer *SizeInterval::select(vector<BackendServer> &backends, const string &filename,
+                                    RequestType type, size_t size)
+{
+    if (type != RequestType::PUT)
     {
-        return nullptr;
+        PlacementShard &shard = shard_for(filename);
+        shared_lock<shared_mutex> lock(shard.lock);
+        auto it = shard.files.find(filename);
+        if (it == shard.files.end())
+        {
+            size = 0;
+        }
+        else if (it->second.backend->is_healthy())
+        {
+            return it->second.backend;
+        }
+        else
+        {
+            size = it->second.size;
+        }
     }
 
-    BackendServer *best = nullptr;
-    double min_rtt = numeric_limits<double>::max();
+    shared_ptr<const SizeProfile> snapshot = atomic_load(&profile);
+    if (size == 0 || !snapshot)
+    {
+        return select(backends);
+    }
 
+    vector<BackendServer *> healthy;
     for (auto &backend : backends)
     {
-        if (backend.healthy && backend.avg_rtt_ms < min_rtt)
+        if (backend.is_healthy())
         {
-            min_rtt = backend.avg_rtt_ms;
-            best = &backend;
+            healthy.push_back(&backend);
         }
     }
+    if (healthy.empty())
+    {
+        return select(backends);
+    }
+    return healthy[size_class(*snapshot, size, healthy.size())];
+}
 
-    if (!best)
+bool SizeInterval::holder_known(const string &filename)
+{
+    PlacementShard &shard = shard_for(filename);
+    shared_lock<shared_mutex> lock(shard.lock);
+    auto it = shard.files.find(filename);
+    return it != shard.files.end() && it->second.backend->is_healthy();
+}
+
+void SizeInterval::record_size(const string &filename, size_t size, BackendServer &backend)
+{
+    PlacementShard &shard = shard_for(filename);
+    bool known;
+    {
+        shared_lock<shared_mutex> lock(shard.lock);
+        auto it = shard.files.find(filename);
+        known = (it != shard.files.end() && it->second.backend == &backend &&
+                 it->second.size == size);
+    }
+    if (!known)
     {
-        best = &backends[0];
+        unique_lock<shared_mutex> lock(shard.lock);
+        shard.files[filename] = {&backend, size};
     }
 
-    return best;
+    vector<size_t> window;
+    {
+        lock_guard<mutex> lock(samples_lock);
+        if (samples.size() < SAMPLE_WINDOW)
+        {
+            samples.push_back(size);
+        }
+        else
+        {
+            samples[next_sample] = size;
+            next_sample = (next_sample + 1) % SAMPLE_WINDOW;
+        }
+        // Refresh often until the window has some history, then every
+        // REFRESH_EVERY samples.
+        if (++since_refresh < min(REFRESH_EVERY, samples.size()))
+        {
+            return;
+        }
+        since_refresh = 0;
+        window = samples;
+    }
+
+    auto next = make_shared<SizeProfile>();
+    sort(window.begin(), window.end());
+    next->bytes_below.reserve(window.size() + 1);
+    double running = 0;
+    for (size_t bytes : window)
+    {
+        next->bytes_below.push_back(running);
+        running += bytes;
+    }
+    next->bytes_below.push_back(running);
+    next->total_bytes = running;
+    next->sizes = move(window);
+    atomic_store(&profile, shared_ptr<const SizeProfile>(move(next)));
 }
 
 unique_ptr<LBAlgorithm> create_lb_algorithm(LBAlgorithmType type,
@@ -78,6 +296,18 @@ unique_ptr<LBAlgorithm> create_lb_algorithm(LBAlgorithmType type,
         return make_unique<RoundRobinLB>(backends);
     case LBAlgorithmType::LEAST_RESPONSE_TIME:
         return make_unique<LeastResponseTimeLB>(backends);
+    case LBAlgorithmType::LEAST_CONNECTIONS:
+        return make_unique<LeastConnectionsLB>(backends);
+    case LBAlgorithmType::WEIGHTED_LEAST_OUTSTANDING:
+        return make_unique<WeightedLeastOutstandingLB>(backends);
+    case LBAlgorithmType::POWER_OF_TWO_CHOICES:
+        return make_unique<PowerOfTwoChoicesLB>(backends);
+    case LBAlgorithmType::PEAK_EWMA:
+        return make_unique<PeakEWMALB>(backends);
+    case LBAlgorithmType::CONSISTENT_HASH:
+        return make_unique<ConsistentHashLB>(backends);
+    case LBAlgorithmType::SIZE_INTERVAL:
+        return make_unique<SizeIntervalLB>(backends);
     default:
         throw runtime_error("Unknown LB algorithm type");
     }
@@ -96,7 +326,31 @@ LBAlgorithmType parse_lb_algorithm(const string &algo_str)
     {
         return LBAlgorithmType::LEAST_RESPONSE_TIME;
     }
+    if (lower == "lc" || lower == "least_connections" || lower == "leastconnections")
+    {
+        return LBAlgorithmType::LEAST_CONNECTIONS;
+    }
+    if (lower == "wlo" || lower == "weighted_least_outstanding")
+    {
+        return LBAlgorithmType::WEIGHTED_LEAST_OUTSTANDING;
+    }
+    if (lower == "p2c" || lower == "power_of_two")
+    {
+        return LBAlgorithmType::POWER_OF_TWO_CHOICES;
+    }
+    if (lower == "peak_ewma" || lower == "peakewma" || lower == "ewma")
+    {
+        return LBAlgorithmType::PEAK_EWMA;
+    }
+    if (lower == "chash" || lower == "consistent_hash" || lower == "maglev")
+    {
+        return LBAlgorithmType::CONSISTENT_HASH;
+    }
+    if (lower == "sita" || lower == "size_interval")
+    {
+        return LBAlgorithmType::SIZE_INTERVAL;
+    }
 
     throw runtime_error("Invalid LB algorithm: " + algo_str +
-                        " (must be rr or lrt)");
+                        " (must be rr, lrt, lc, wlo, p2c, peak_ewma, chash or sita)");
 }
\ No newline at end of file
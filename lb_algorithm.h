@@ -2,50 +2,578 @@
 #define LB_ALGORITHM_H
 
 #include "lb_config.h"
+#include "protocol.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 
 using namespace std;
 
 enum class LBAlgorithmType {
     ROUND_ROBIN,
-    LEAST_RESPONSE_TIME
+    LEAST_RESPONSE_TIME,
+    LEAST_CONNECTIONS,
+    WEIGHTED_LEAST_OUTSTANDING,
+    POWER_OF_TWO_CHOICES,
+    PEAK_EWMA,
+    CONSISTENT_HASH,
+    SIZE_INTERVAL
 };
 
 class LBAlgorithm {
 protected:
     vector<BackendServer>& backends;
-    mutex selection_mutex;
     
 public:
     LBAlgorithm(vector<BackendServer>& backend_list) : backends(backend_list) {}
     virtual ~LBAlgorithm() {}
     
     virtual BackendServer* select_backend() = 0;
+
+    // Selection for one request. Content-aware algorithms (chash, sita)
+    // route on the request; the others ignore it. size is the PUT body
+    // size, or 0 for a GET.
+    virtual BackendServer* select_backend(const string& filename, RequestType type, size_t size)
+    {
+        (void)filename;
+        (void)type;
+        (void)size;
+        return select_backend();
+    }
+
+    // Called after a request succeeds with the file's size (from the PUT's
+    // SIZE line or the GET response's) and the backend that stored or
+    // served it, for algorithms that learn sizes and placements.
+    virtual void record_size(const string& filename, size_t size, BackendServer& backend)
+    {
+        (void)filename;
+        (void)size;
+        (void)backend;
+    }
+
+    // True when the backend select_backend() picks for a GET of this file
+    // is the only one that has it (chash, or sita once it knows where the
+    // file was stored), so a duplicate sent elsewhere cannot succeed.
+    virtual bool holder_known(const string& filename)
+    {
+        (void)filename;
+        return false;
+    }
+
+    // For algorithms that decide where each copy of a replicated file
+    // lives (chash): set_copies() is called once at startup with the
+    // replication factor, and place_copies() gives the backends to write
+    // count copies to, owner first. Empty when the algorithm leaves that
+    // to the caller.
+    virtual void set_copies(size_t count) { (void)count; }
+
+    virtual vector<BackendServer*> place_copies(const string& filename, size_t count)
+    {
+        (void)filename;
+        (void)count;
+        return {};
+    }
+
     virtual string get_name() const = 0;
 };
 
-class RoundRobinLB : public LBAlgorithm {
+// Selection rules. Each is a plain struct with an inline, non-virtual
+// select() for Balancer<Algo>. They are called concurrently from every LB
+// thread, so any state they keep is atomic and they never lock; backend
+// health is read from BackendServer's atomics.
+struct RoundRobin {
+    static const char* name() { return "Round Robin"; }
+
+    // One fetch_add per selection. When the claimed backend is down the
+    // scan moves on to the next healthy one without advancing the cursor
+    // further, so that backend briefly takes the failed one's turns too.
+    atomic<size_t> cursor{0};
+
+    BackendServer* select(vector<BackendServer>& backends)
+    {
+        if (backends.empty())
+        {
+            return nullptr;
+        }
+
+        size_t start_index = cursor.fetch_add(1, memory_order_relaxed) % backends.size();
+        for (size_t attempts = 0; attempts < backends.size(); ++attempts)
+        {
+            BackendServer& backend = backends[(start_index + attempts) % backends.size()];
+            if (backend.is_healthy())
+            {
+                return &backend;
+            }
+        }
+
+        return &backends[start_index];
+    }
+};
+
+struct LeastResponseTime {
+    static const char* name() { return "Least Response Time"; }
+
+    BackendServer* select(vector<BackendServer>& backends)
+    {
+        if (backends.empty())
+        {
+            return nullptr;
+        }
+
+        BackendServer* best = nullptr;
+        double min_rtt = numeric_limits<double>::max();
+        for (auto& backend : backends)
+        {
+            double rtt = backend.rtt_ms();
+            if (backend.is_healthy() && rtt < min_rtt)
+            {
+                min_rtt = rtt;
+                best = &backend;
+            }
+        }
+        return best ? best : &backends[0];
+    }
+};
+
+// Healthy backend with the lowest score(backend), scanning from
+// start_index; ties go to the first one scanned. With no healthy backend
+// it returns the one at start_index.
+template <typename Score>
+BackendServer* select_lowest_from(vector<BackendServer>& backends, size_t start_index,
+                                  Score score)
+{
+    BackendServer* best = nullptr;
+    double best_score = numeric_limits<double>::max();
+    for (size_t i = 0; i < backends.size(); ++i)
+    {
+        BackendServer& backend = backends[(start_index + i) % backends.size()];
+        if (!backend.is_healthy())
+        {
+            continue;
+        }
+        double value = score(backend);
+        if (value < best_score)
+        {
+            best_score = value;
+            best = &backend;
+        }
+    }
+    return best ? best : &backends[start_index];
+}
+
+// As above, from a rotating offset so that ties (e.g. every backend idle)
+// are spread across backends instead of all going to the first one.
+template <typename Score>
+BackendServer* select_lowest(vector<BackendServer>& backends, atomic<size_t>& cursor,
+                             Score score)
+{
+    if (backends.empty())
+    {
+        return nullptr;
+    }
+    size_t start_index = cursor.fetch_add(1, memory_order_relaxed) % backends.size();
+    return select_lowest_from(backends, start_index, score);
+}
+
+// Uniform index below bound from a per-thread xorshift generator, so
+// sampling shares no state between LB threads.
+inline size_t random_index(size_t bound)
+{
+    thread_local uint64_t state =
+        (hash<thread::id>()(this_thread::get_id()) ^
+         static_cast<uint64_t>(chrono::steady_clock::now().time_since_epoch().count())) |
+        1;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return static_cast<size_t>(state % bound);
+}
+
+// Samples two distinct backends and keeps the one with the lower score.
+// Unlike a full scan, concurrent selections do not all pile onto the same
+// global minimum. If either sample is down the other is used; if both are,
+// it falls back to scanning from the first sample.
+template <typename Score>
+BackendServer* select_two_choices(vector<BackendServer>& backends, Score score)
+{
+    size_t count = backends.size();
+    if (count < 2)
+    {
+        return count ? &backends[0] : nullptr;
+    }
+
+    size_t first = random_index(count);
+    size_t second = random_index(count - 1);
+    if (second >= first)
+    {
+        ++second;
+    }
+
+    BackendServer& a = backends[first];
+    BackendServer& b = backends[second];
+    bool a_up = a.is_healthy();
+    bool b_up = b.is_healthy();
+    if (a_up && b_up)
+    {
+        return score(b) < score(a) ? &b : &a;
+    }
+    if (a_up || b_up)
+    {
+        return a_up ? &a : &b;
+    }
+    return select_lowest_from(backends, first, score);
+}
+
+// Fewest requests currently being forwarded (BackendServer::in_flight).
+struct LeastConnections {
+    static const char* name() { return "Least Connections"; }
+
+    atomic<size_t> cursor{0};
+
+    BackendServer* select(vector<BackendServer>& backends)
+    {
+        return select_lowest(backends, cursor, [](const BackendServer& backend)
+                             { return static_cast<double>(backend.outstanding()); });
+    }
+};
+
+// Lowest (in_flight + 1) / weight: a backend with weight 2 is given twice
+// the outstanding requests of a weight-1 backend before it looks busier.
+// The +1 counts the request being placed, so idle backends still order by
+// weight.
+struct WeightedLeastOutstanding {
+    static const char* name() { return "Weighted Least Outstanding"; }
+
+    atomic<size_t> cursor{0};
+
+    BackendServer* select(vector<BackendServer>& backends)
+    {
+        return select_lowest(backends, cursor, [](const BackendServer& backend)
+                             { return (backend.outstanding() + 1) / backend.weight; });
+    }
+};
+
+// Power of two choices on in-flight requests.
+struct PowerOfTwoChoices {
+    static const char* name() { return "Power of Two Choices"; }
+
+    BackendServer* select(vector<BackendServer>& backends)
+    {
+        return select_two_choices(backends, [](const BackendServer& backend)
+                                  { return static_cast<double>(backend.outstanding()); });
+    }
+};
+
+// Peak EWMA: expected latency (the request-latency EWMA, or the health
+// probe RTT before any request has completed) times (in_flight + 1),
+// compared over two random choices.
+struct PeakEWMA {
+    static const char* name() { return "Peak EWMA"; }
+
+    static double cost(const BackendServer& backend)
+    {
+        double latency = backend.latency_ms();
+        if (latency == 0.0)
+        {
+            latency = backend.rtt_ms();
+        }
+        return latency * (backend.outstanding() + 1);
+    }
+
+    BackendServer* select(vector<BackendServer>& backends)
+    {
+        return select_two_choices(backends, cost);
+    }
+};
+
+// Maglev lookup table built over the backends that were healthy at build
+// time. slots[i] is an index into the backend list.
+struct MaglevTable {
+    static const size_t SIZE = 65537;
+    static const uint16_t EMPTY = 0xffff;
+
+    vector<bool> healthy;
+    vector<uint16_t> slots;
+};
+
+// Content affinity: a filename hashes onto a Maglev table, so a GET goes to
+// the backend that took the file's PUT and each file is stored on one
+// backend. When the health checker flips a backend, the next selection
+// sees a different healthy set and publishes a rebuilt table; Maglev moves
+// only about the keys of the backend that changed. With --replicas R a
+// file is written to the first R distinct backends in table order from
+// its slot (place_copies), and a GET whose owner has more than
+// LOAD_FACTOR x the mean in-flight load, and at least SPILL_FLOOR
+// requests, spills to the next of those (bounded load), so a hot file
+// cannot swamp its owner. A GET never spills past them: no other backend
+// has the file. With one copy every request goes to the owner.
+struct ConsistentHash {
+    static const char* name() { return "Consistent Hash (Maglev)"; }
+    static constexpr double LOAD_FACTOR = 1.25;
+    static const int SPILL_FLOOR = 8;
+
+    // Copies of each file (--replicas); set once at startup.
+    size_t copies = 1;
+
+    // Read and replaced with atomic_load/atomic_store.
+    shared_ptr<const MaglevTable> table;
+    atomic<size_t> cursor{0};
+
+    // Requests without a filename: least connections.
+    BackendServer* select(vector<BackendServer>& backends)
+    {
+        return select_lowest(backends, cursor, [](const BackendServer& backend)
+                             { return static_cast<double>(backend.outstanding()); });
+    }
+
+    BackendServer* select(vector<BackendServer>& backends, const string& filename,
+                          RequestType type, size_t size);
+
+    // The first count distinct backends in table order from the file's
+    // slot; the first is its owner.
+    vector<BackendServer*> place_copies(vector<BackendServer>& backends, const string& filename,
+                                        size_t count);
+
+    shared_ptr<const MaglevTable> current_table(const vector<BackendServer>& backends);
+};
+
+shared_ptr<const MaglevTable> build_maglev_table(const vector<BackendServer>& backends);
+
+// Recent request sizes, sorted, with bytes_below[i] the sum of sizes[0..i).
+struct SizeProfile {
+    vector<size_t> sizes;
+    vector<double> bytes_below;
+    double total_bytes = 0;
+};
+
+// Size-interval task assignment (SITA-E). The healthy backends, in config
+// order, each take one contiguous size class; the cutoffs split the bytes
+// of the last SAMPLE_WINDOW requests evenly, so each backend carries about
+// the same load and small files never queue behind large ones. The cutoffs
+// are recomputed every REFRESH_EVERY samples, and for however many
+// backends are healthy at selection time. PUTs are placed by the SIZE
+// line. Because the cutoffs and the healthy set move, a GET does not
+// recompute its class: it goes to the backend that last stored or served
+// the file, while that backend is healthy. Otherwise it is placed by the
+// file's learned size, and a file of unknown size goes to the
+// least-loaded backend.
+struct SizeInterval {
+    static const char* name() { return "Size Interval (SITA)"; }
+    static const size_t SAMPLE_WINDOW = 4096;
+    static const size_t REFRESH_EVERY = 256;
+    static const size_t PLACEMENT_SHARDS = 16;
+
+    struct Placement {
+        BackendServer* backend;
+        size_t size;
+    };
+
+    // filename -> placement, hash-partitioned like the server's FileStore
+    // so GETs of different files rarely meet on a lock. Lookups take the
+    // reader side; only first sightings and moves take the writer side.
+    struct PlacementShard {
+        shared_mutex lock;
+        unordered_map<string, Placement> files;
+    };
+    array<PlacementShard, PLACEMENT_SHARDS> placements;
+
+    mutex samples_lock;
+    vector<size_t> samples;
+    size_t next_sample = 0;
+    size_t since_refresh = 0;
+
+    // Read and replaced with atomic_load/atomic_store.
+    shared_ptr<const SizeProfile> profile;
+    atomic<size_t> cursor{0};
+
+    BackendServer* select(vector<BackendServer>& backends)
+    {
+        return select_lowest(backends, cursor, [](const BackendServer& backend)
+                             { return static_cast<double>(backend.outstanding()); });
+    }
+
+    BackendServer* select(vector<BackendServer>& backends, const string& filename,
+                          RequestType type, size_t size);
+
+    void record_size(const string& filename, size_t size, BackendServer& backend);
+
+    // Whether the file's GETs go to the backend recorded for it.
+    bool holder_known(const string& filename);
+
+    // Size class in [0, classes) for a request of this many bytes.
+    static size_t size_class(const SizeProfile& profile, size_t size, size_t classes);
+
+    PlacementShard& shard_for(const string& filename)
+    {
+        return placements[hash<string>{}(filename) % PLACEMENT_SHARDS];
+    }
+};
+
+// How fast latency_ewma_ms forgets: a sample's weight decays by e every
+// PEAK_EWMA_DECAY_MS.
+const double PEAK_EWMA_DECAY_MS = 5000.0;
+
+// Folds one completed request's latency into backend.latency_ewma_ms. A
+// sample above the current value replaces it outright (the "peak"), so a
+// backend that slows down is avoided at once; lower samples pull it down
+// by a weight that grows with the time since the previous sample.
+void record_latency(BackendServer& backend, double latency_ms);
+
+// Holds one in_flight slot on a backend for its lifetime.
+class InFlightGuard {
 private:
-    size_t current_index;
-    
+    BackendServer& backend;
+
 public:
-    RoundRobinLB(vector<BackendServer>& backend_list);
-    BackendServer* select_backend() override;
-    string get_name() const override { return "Round Robin"; }
+    explicit InFlightGuard(BackendServer& server) : backend(server)
+    {
+        backend.in_flight.fetch_add(1, memory_order_relaxed);
+    }
+    ~InFlightGuard() { backend.in_flight.fetch_sub(1, memory_order_relaxed); }
+
+    InFlightGuard(const InFlightGuard&) = delete;
+    InFlightGuard& operator=(const InFlightGuard&) = delete;
 };
 
-class LeastResponseTimeLB : public LBAlgorithm {
+template <typename Algo, typename = void>
+struct routes_by_request : false_type {};
+
+template <typename Algo>
+struct routes_by_request<Algo, void_t<decltype(declval<Algo&>().select(
+                                   declval<vector<BackendServer>&>(), declval<const string&>(),
+                                   RequestType::GET, size_t()))>> : true_type {};
+
+template <typename Algo, typename = void>
+struct places_copies : false_type {};
+
+template <typename Algo>
+struct places_copies<Algo, void_t<decltype(declval<Algo&>().place_copies(
+                               declval<vector<BackendServer>&>(), declval<const string&>(),
+                               size_t()))>> : true_type {};
+
+template <typename Algo, typename = void>
+struct tracks_holders : false_type {};
+
+template <typename Algo>
+struct tracks_holders<Algo, void_t<decltype(declval<Algo&>().holder_known(
+                                declval<const string&>()))>> : true_type {};
+
+template <typename Algo, typename = void>
+struct learns_sizes : false_type {};
+
+template <typename Algo>
+struct learns_sizes<Algo, void_t<decltype(declval<Algo&>().record_size(
+                              declval<const string&>(), size_t(),
+                              declval<BackendServer&>()))>> : true_type {};
+
+// Binds one selection rule to the backend list. The class is final, so
+// code holding a Balancer<Algo>* (the thread-mode acceptor, instantiated
+// per algorithm in main()) gets select() inlined; the event loops keep an
+// LBAlgorithm* and pay one virtual call per connection. Rules that route
+// on the request or learn sizes are detected at compile time.
+template <typename Algo>
+class Balancer final : public LBAlgorithm {
+private:
+    Algo algo;
+
 public:
-    LeastResponseTimeLB(vector<BackendServer>& backend_list);
-    BackendServer* select_backend() override;
-    string get_name() const override { return "Least Response Time"; }
+    explicit Balancer(vector<BackendServer>& backend_list) : LBAlgorithm(backend_list) {}
+
+    BackendServer* select_backend() override { return algo.select(backends); }
+
+    BackendServer* select_backend(const string& filename, RequestType type, size_t size) override
+    {
+        if constexpr (routes_by_request<Algo>::value)
+        {
+            return algo.select(backends, filename, type, size);
+        }
+        else
+        {
+            (void)filename;
+            (void)type;
+            (void)size;
+            return algo.select(backends);
+        }
+    }
+
+    void record_size(const string& filename, size_t size, BackendServer& backend) override
+    {
+        if constexpr (learns_sizes<Algo>::value)
+        {
+            algo.record_size(filename, size, backend);
+        }
+        else
+        {
+            (void)filename;
+            (void)size;
+            (void)backend;
+        }
+    }
+
+    bool holder_known(const string& filename) override
+    {
+        if constexpr (tracks_holders<Algo>::value)
+        {
+            return algo.holder_known(filename);
+        }
+        else
+        {
+            (void)filename;
+            return routes_by_request<Algo>::value;
+        }
+    }
+
+    void set_copies(size_t count) override
+    {
+        if constexpr (places_copies<Algo>::value)
+        {
+            algo.copies = count;
+        }
+        else
+        {
+            (void)count;
+        }
+    }
+
+    vector<BackendServer*> place_copies(const string& filename, size_t count) override
+    {
+        if constexpr (places_copies<Algo>::value)
+        {
+            return algo.place_copies(backends, filename, count);
+        }
+        else
+        {
+            (void)filename;
+            (void)count;
+            return {};
+        }
+    }
+
+    string get_name() const override { return Algo::name(); }
 };
 
+using RoundRobinLB = Balancer<RoundRobin>;
+using LeastResponseTimeLB = Balancer<LeastResponseTime>;
+using LeastConnectionsLB = Balancer<LeastConnections>;
+using WeightedLeastOutstandingLB = Balancer<WeightedLeastOutstanding>;
+using PowerOfTwoChoicesLB = Balancer<PowerOfTwoChoices>;
+using PeakEWMALB = Balancer<PeakEWMA>;
+using ConsistentHashLB = Balancer<ConsistentHash>;
+using SizeIntervalLB = Balancer<SizeInterval>;
+
 unique_ptr<LBAlgorithm> create_lb_algorithm(LBAlgorithmType type, 
                                              vector<BackendServer>& backends);
 
 LBAlgorithmType parse_lb_algorithm(const string& algo_str);
 
-#endif
\ No newline at end of file
+#endif
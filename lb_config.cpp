@@ -23,6 +23,19 @@ static string extract_string_value(const string &line)
     return trim(value);
 }
 
+static double extract_double_value(const string &line)
+{
+    string value = extract_string_value(line);
+    try
+    {
+        return stod(value);
+    }
+    catch (...)
+    {
+        throw runtime_error("Invalid number in config: " + line);
+    }
+}
+
 static int extract_int_value(const string &line)
 {
     string value = extract_string_value(line);
@@ -49,6 +62,7 @@ LBConfig parse_lb_config(const string &filename)
     bool found_lb_ip = false, found_lb_port = false;
     vector<string> backend_ips(4);
     vector<int> backend_ports(4);
+    vector<double> backend_weights(4, 1.0);
     vector<bool> found_backends(4, false);
 
     while (getline(file, line))
@@ -71,6 +85,7 @@ LBConfig parse_lb_config(const string &filename)
             {
                 string server_ip_key = "server" + to_string(i) + "_ip";
                 string server_port_key = "server" + to_string(i) + "_port";
+                string server_weight_key = "server" + to_string(i) + "_weight";
 
                 if (line.find(server_ip_key) != string::npos)
                 {
@@ -81,6 +96,14 @@ LBConfig parse_lb_config(const string &filename)
                 {
                     backend_ports[i - 1] = extract_int_value(line);
                 }
+                else if (line.find(server_weight_key) != string::npos)
+                {
+                    backend_weights[i - 1] = extract_double_value(line);
+                    if (backend_weights[i - 1] <= 0)
+                    {
+                        throw runtime_error(server_weight_key + " must be positive");
+                    }
+                }
             }
         }
     }
@@ -96,7 +119,7 @@ LBConfig parse_lb_config(const string &filename)
         {
             throw runtime_error("Missing server" + to_string(i + 1) + " configuration");
         }
-        config.backends.emplace_back(i + 1, backend_ips[i], backend_ports[i]);
+        config.backends.emplace_back(i + 1, backend_ips[i], backend_ports[i], backend_weights[i]);
     }
 
     if (config.lb_port < 1024 || config.lb_port > 65535)
@@ -1,6 +1,7 @@
 #ifndef LB_CONFIG_H
 #define LB_CONFIG_H
 
+#include <atomic>
 #include <string>
 #include <vector>
 #include <stdexcept>
@@ -8,22 +9,64 @@
 
 using namespace std;
 
+// healthy and avg_rtt_ms are written by the health checker while LB
+// threads select on them, so they are atomics and selection needs no lock.
+// in_flight counts requests the LB is forwarding to this backend right
+// now, and latency_ewma_ms tracks their completion times (record_latency()
+// in lb_algorithm.h). consecutive_failures and last_check are only touched by the checker.
+// The backend list is fixed once the config is parsed; copies are only
+// made while building it.
 struct BackendServer {
     string ip;
     int port;
     int id;
+    double weight;
     
-    bool healthy;
-    double avg_rtt_ms;
+    atomic<bool> healthy;
+    atomic<double> avg_rtt_ms;
+    atomic<int> in_flight;
+    atomic<double> latency_ewma_ms;
+    atomic<long long> latency_updated_ns;
     int consecutive_failures;
     chrono::steady_clock::time_point last_check;
     
-    BackendServer() : port(0), id(0), healthy(true), avg_rtt_ms(0.0), 
+    BackendServer() : port(0), id(0), weight(1.0), healthy(true), avg_rtt_ms(0.0), 
+                      in_flight(0), latency_ewma_ms(0.0), latency_updated_ns(0),
                       consecutive_failures(0) {}
     
-    BackendServer(int server_id, string server_ip, int server_port) 
-        : ip(server_ip), port(server_port), id(server_id), 
-          healthy(true), avg_rtt_ms(0.0), consecutive_failures(0) {}
+    BackendServer(int server_id, string server_ip, int server_port, double server_weight = 1.0) 
+        : ip(server_ip), port(server_port), id(server_id), weight(server_weight),
+          healthy(true), avg_rtt_ms(0.0), in_flight(0), latency_ewma_ms(0.0),
+          latency_updated_ns(0), consecutive_failures(0) {}
+
+    BackendServer(const BackendServer &other)
+        : ip(other.ip), port(other.port), id(other.id), weight(other.weight),
+          healthy(other.is_healthy()), avg_rtt_ms(other.rtt_ms()),
+          in_flight(other.outstanding()), latency_ewma_ms(other.latency_ms()),
+          latency_updated_ns(other.latency_updated_ns.load(memory_order_relaxed)),
+          consecutive_failures(other.consecutive_failures), last_check(other.last_check) {}
+
+    BackendServer &operator=(const BackendServer &other)
+    {
+        ip = other.ip;
+        port = other.port;
+        id = other.id;
+        weight = other.weight;
+        healthy.store(other.is_healthy(), memory_order_relaxed);
+        avg_rtt_ms.store(other.rtt_ms(), memory_order_relaxed);
+        in_flight.store(other.outstanding(), memory_order_relaxed);
+        latency_ewma_ms.store(other.latency_ms(), memory_order_relaxed);
+        latency_updated_ns.store(other.latency_updated_ns.load(memory_order_relaxed),
+                                 memory_order_relaxed);
+        consecutive_failures = other.consecutive_failures;
+        last_check = other.last_check;
+        return *this;
+    }
+
+    bool is_healthy() const { return healthy.load(memory_order_relaxed); }
+    double rtt_ms() const { return avg_rtt_ms.load(memory_order_relaxed); }
+    int outstanding() const { return in_flight.load(memory_order_relaxed); }
+    double latency_ms() const { return latency_ewma_ms.load(memory_order_relaxed); }
 };
 
 struct LBConfig {
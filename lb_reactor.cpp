@@ -0,0 +1,823 @@
+#include "lb_reactor.h"
+#include "utils.h"
+#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+using namespace std;
+
+bool set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0)
+    {
+        return false;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+bool EarlyEndDetector::feed(const char *data, size_t len)
+{
+    size_t i = 0;
+    while (i < len)
+    {
+        const char *eol = static_cast<const char *>(memchr(data + i, '\n', len - i));
+        size_t take = eol ? static_cast<size_t>(eol - (data + i)) : len - i;
+        for (size_t k = 0; k < take && matches_end; ++k)
+        {
+            matches_end = (line_length + k < PROTOCOL_END.size() &&
+                           data[i + k] == PROTOCOL_END[line_length + k]);
+        }
+        line_length += take;
+        i += take;
+        if (!eol)
+        {
+            break;
+        }
+
+        if (matches_end && line_length == PROTOCOL_END.size())
+        {
+            return true;
+        }
+        line_length = 0;
+        matches_end = true;
+        ++i;
+    }
+    return false;
+}
+
+size_t ResponseFramer::feed(const char *data, size_t len)
+{
+    size_t i = 0;
+    while (i < len)
+    {
+        if (phase == Phase::UNFRAMED)
+        {
+            return len;
+        }
+        if (phase == Phase::DONE || phase == Phase::FAILED)
+        {
+            return i;
+        }
+        if (phase == Phase::BODY)
+        {
+            size_t take = min(len - i, body_remaining);
+            size_t trailer = PROTOCOL_END.size() + 1;
+            size_t file_bytes = body_remaining > trailer ? min(take, body_remaining - trailer) : 0;
+            if (early_end.feed(data + i, file_bytes))
+            {
+                ok = false;
+                phase = Phase::FAILED;
+                return i;
+            }
+            i += take;
+            body_remaining -= take;
+            if (body_remaining == 0)
+            {
+                phase = Phase::DONE;
+            }
+            continue;
+        }
+
+        const char *eol = static_cast<const char *>(memchr(data + i, '\n', len - i));
+        size_t take = eol ? static_cast<size_t>(eol - (data + i)) : len - i;
+        line.append(data + i, take);
+        i += take + (eol ? 1 : 0);
+
+        if (line.size() > MAX_LINE)
+        {
+            phase = Phase::UNFRAMED;
+            return len;
+        }
+        if (!eol)
+        {
+            break;
+        }
+
+        if (phase == Phase::STATUS)
+        {
+            ok = (line == PROTOCOL_OK);
+            phase = (ok && expect_body) ? Phase::SIZE : Phase::DONE;
+        }
+        else
+        {
+            size_t file_size = 0;
+            if (!parse_size_line(line, file_size))
+            {
+                ok = false;
+                phase = Phase::UNFRAMED;
+                return len;
+            }
+            body_size = file_size;
+            body_remaining = file_size + PROTOCOL_END.size() + 1;
+            phase = Phase::BODY;
+        }
+        line.clear();
+    }
+    return i;
+}
+
+void LBReactor::RelayBuffer::compact()
+{
+    if (start == end)
+    {
+        start = end = 0;
+    }
+    else if (start > 0 && end == RELAY_BUFFER_SIZE)
+    {
+        memmove(data, data + start, end - start);
+        end -= start;
+        start = 0;
+    }
+}
+
+LBReactor::LBReactor(int listen_sock, LBAlgorithm *algo, BackendPool *backend_pool,
+                     atomic<bool> &shutdown_flag, RequestLogger request_logger)
+    : listen_fd(listen_sock), epoll_fd(-1), lb_algo(algo), pool(backend_pool),
+      shutdown(shutdown_flag), logger(request_logger), active_connections(0),
+      last_sweep_ns(get_current_time_ns())
+{
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0)
+    {
+        throw runtime_error("epoll_create1 failed: " + string(strerror(errno)));
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.ptr = nullptr;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0)
+    {
+        close(epoll_fd);
+        throw runtime_error("Cannot register listening socket: " + string(strerror(errno)));
+    }
+}
+
+LBReactor::~LBReactor()
+{
+    if (epoll_fd >= 0)
+    {
+        close(epoll_fd);
+    }
+}
+
+void LBReactor::run()
+{
+    struct epoll_event events[MAX_EVENTS];
+
+    while (!shutdown)
+    {
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, 100);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            cerr << "[LB] epoll_wait failed: " << strerror(errno) << endl;
+            break;
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+            if (events[i].data.ptr == nullptr)
+            {
+                accept_connections();
+            }
+            else
+            {
+                handle_event(static_cast<Endpoint *>(events[i].data.ptr), events[i].events);
+            }
+        }
+
+        long long now = get_current_time_ns();
+        if (now - last_sweep_ns >= SWEEP_INTERVAL_MS * 1'000'000LL)
+        {
+            last_sweep_ns = now;
+            expire_idle(now);
+        }
+
+        for (auto *conn : closing)
+        {
+            delete conn;
+        }
+        closing.clear();
+    }
+
+    cout << "[LB] Event loop exiting (" << active_connections
+         << " connections still open)" << endl;
+}
+
+void LBReactor::expire_idle(long long now)
+{
+    vector<Connection *> expired;
+    for (auto *conn : live)
+    {
+        if (now - conn->last_active_ns >= IDLE_TIMEOUT_MS * 1'000'000LL)
+        {
+            expired.push_back(conn);
+        }
+    }
+
+    for (auto *conn : expired)
+    {
+        cerr << "[LB] Closing connection idle for " << IDLE_TIMEOUT_MS << " ms" << endl;
+        // The client can still be told why unless response bytes went out.
+        bool replied = conn->response.phase != ResponseFramer::Phase::STATUS ||
+                       conn->downstream.pending() > 0;
+        if (replied)
+        {
+            release(conn);
+        }
+        else
+        {
+            fail(conn, "Request timed out");
+        }
+    }
+}
+
+void LBReactor::accept_connections()
+{
+    while (!shutdown)
+    {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+
+        int client_sock = accept4(listen_fd, (struct sockaddr *)&client_addr, &client_len,
+                                  SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_sock < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK && !shutdown)
+            {
+                cerr << "[LB] accept failed: " << strerror(errno) << endl;
+            }
+            return;
+        }
+
+        Connection *conn = new Connection();
+        conn->client = {conn, client_sock, 0, false, false};
+        conn->backend = {conn, -1, 0, false, false};
+        conn->state = ConnState::READ_HEADER;
+        conn->type = RequestType::UNKNOWN;
+        conn->file_size = 0;
+        conn->selected = nullptr;
+        conn->start_ns = get_current_time_ns();
+        conn->selected_ns = 0;
+        conn->last_active_ns = conn->start_ns;
+        conn->backend_reusable = false;
+        conn->closed = false;
+        conn->preamble_sent = 0;
+        conn->request_remaining = 0;
+        conn->body_unscanned = 0;
+        live.insert(conn);
+        active_connections++;
+
+        update_interest(conn->client, EPOLLIN);
+    }
+}
+
+void LBReactor::handle_event(Endpoint *ep, uint32_t events)
+{
+    Connection *conn = ep->conn;
+    if (conn->closed)
+    {
+        return;
+    }
+
+    bool is_client = (ep == &conn->client);
+    conn->last_active_ns = get_current_time_ns();
+
+    if (is_client)
+    {
+        if (events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        {
+            bool header_done = (conn->state != ConnState::READ_HEADER);
+            size_t limit = header_done ? conn->request_remaining : RELAY_BUFFER_SIZE;
+            ssize_t received = fill(conn->client, conn->upstream, limit);
+            if (received < 0)
+            {
+                release(conn);
+                return;
+            }
+            if (header_done)
+            {
+                conn->request_remaining -= received;
+                const char *data = conn->upstream.data + conn->upstream.end - received;
+                if (!scan_request_body(conn, data, received))
+                {
+                    return;
+                }
+            }
+        }
+        if (events & EPOLLOUT)
+        {
+            if (!drain(conn->client, conn->downstream))
+            {
+                release(conn);
+                return;
+            }
+        }
+
+        if (conn->state == ConnState::READ_HEADER)
+        {
+            if (!parse_header(conn))
+            {
+                return;
+            }
+        }
+    }
+    else if (conn->state == ConnState::CONNECTING)
+    {
+        if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+        {
+            on_backend_connected(conn);
+            if (conn->closed)
+            {
+                return;
+            }
+        }
+    }
+    else
+    {
+        if (events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        {
+            RelayBuffer &buf = conn->downstream;
+            ssize_t received = fill(conn->backend, buf, RELAY_BUFFER_SIZE);
+            if (received < 0)
+            {
+                release(conn);
+                return;
+            }
+            // Compaction moves everything pending, so the bytes just read
+            // are always the last `received` bytes of the buffer. Anything
+            // past the end of the response is dropped.
+            size_t first = buf.end - received;
+            buf.end = first + conn->response.feed(buf.data + first, received);
+            if (conn->response.failed())
+            {
+                cerr << "[LB] Backend " << conn->selected->id
+                     << " ended a GET body before its SIZE" << endl;
+                finish(conn, false);
+                return;
+            }
+        }
+    }
+
+    pump(conn);
+}
+
+ssize_t LBReactor::fill(Endpoint &from, RelayBuffer &buf, size_t limit)
+{
+    size_t total = 0;
+    while (!from.eof && total < limit)
+    {
+        buf.compact();
+        if (buf.space() == 0)
+        {
+            break;
+        }
+
+        ssize_t received = recv(from.fd, buf.data + buf.end, min(buf.space(), limit - total), 0);
+        if (received > 0)
+        {
+            buf.end += received;
+            total += received;
+            continue;
+        }
+        if (received == 0)
+        {
+            from.eof = true;
+            break;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            break;
+        }
+        return -1;
+    }
+    return static_cast<ssize_t>(total);
+}
+
+bool LBReactor::drain(Endpoint &to, RelayBuffer &buf)
+{
+    while (buf.pending() > 0)
+    {
+        ssize_t sent = send(to.fd, buf.data + buf.start, buf.pending(), MSG_NOSIGNAL);
+        if (sent > 0)
+        {
+            buf.start += sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        return sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+    buf.compact();
+    return true;
+}
+
+bool LBReactor::parse_header(Connection *conn)
+{
+    RelayBuffer &buf = conn->upstream;
+    const char *begin = buf.data + buf.start;
+    const char *limit = buf.data + buf.end;
+    const char *pos = begin;
+
+    auto next_line = [&](string &line) -> bool
+    {
+        const char *eol = static_cast<const char *>(memchr(pos, '\n', limit - pos));
+        if (!eol)
+        {
+            return false;
+        }
+        line.assign(pos, eol);
+        pos = eol + 1;
+        return true;
+    };
+
+    auto incomplete = [&]() -> bool
+    {
+        if (buf.space() == 0 || conn->client.eof)
+        {
+            fail(conn, "Malformed request");
+            return false;
+        }
+        refresh_interest(conn);
+        return false;
+    };
+
+    // KEEPALIVE, DEADLINE and CLIENT lines are relayed to the backend as sent.
+    string command;
+    long long deadline_ms = 0;
+    string client_key;
+    do
+    {
+        if (!next_line(command))
+        {
+            return incomplete();
+        }
+    } while (command == PROTOCOL_KEEPALIVE || parse_deadline_line(command, deadline_ms) ||
+             parse_client_line(command, client_key));
+
+    size_t space = command.find(' ');
+    string cmd = command.substr(0, space);
+    size_t body_size = 0;
+
+    if (cmd == PROTOCOL_PUT)
+    {
+        string size_line;
+        if (!next_line(size_line))
+        {
+            return incomplete();
+        }
+        size_t file_size = 0;
+        if (!parse_size_line(size_line, file_size))
+        {
+            fail(conn, "Malformed request");
+            return false;
+        }
+        conn->type = RequestType::PUT;
+        conn->file_size = file_size;
+        body_size = file_size + PROTOCOL_END.size() + 1;
+    }
+    else if (cmd == PROTOCOL_GET)
+    {
+        conn->type = RequestType::GET;
+    }
+    else
+    {
+        fail(conn, "Malformed request");
+        return false;
+    }
+
+    conn->filename = (space == string::npos) ? "" : command.substr(space + 1);
+    if (client_key.empty())
+    {
+        string peer = peer_address(conn->client.fd);
+        if (!peer.empty())
+        {
+            conn->preamble = PROTOCOL_CLIENT + " " + peer + "\n";
+        }
+    }
+    conn->response.expect_body = (conn->type == RequestType::GET);
+
+    size_t request_size = static_cast<size_t>(pos - begin) + body_size;
+    if (buf.pending() > request_size)
+    {
+        buf.end = buf.start + request_size;
+    }
+    conn->request_remaining = request_size - buf.pending();
+    conn->body_unscanned = conn->type == RequestType::PUT ? conn->file_size : 0;
+    if (!scan_request_body(conn, pos, buf.data + buf.end - pos))
+    {
+        return false;
+    }
+
+    start_backend_connect(conn);
+    return !conn->closed;
+}
+
+void LBReactor::start_backend_connect(Connection *conn)
+{
+    BackendServer *backend = lb_algo->select_backend(conn->filename, conn->type, conn->file_size);
+    if (!backend)
+    {
+        cerr << "[LB] No backend available" << endl;
+        fail(conn, "No backend available");
+        return;
+    }
+    conn->selected = backend;
+    conn->selected_ns = get_current_time_ns();
+    backend->in_flight.fetch_add(1, memory_order_relaxed);
+
+    if (pool)
+    {
+        conn->preamble = PROTOCOL_KEEPALIVE + "\n" + conn->preamble;
+
+        int pooled = pool->checkout(*backend);
+        if (pooled >= 0 && set_nonblocking(pooled))
+        {
+            conn->backend.fd = pooled;
+            conn->state = ConnState::RELAYING;
+            return;
+        }
+        if (pooled >= 0)
+        {
+            close(pooled);
+        }
+    }
+
+    int sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0)
+    {
+        fail(conn, "Backend unavailable");
+        return;
+    }
+
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;
+    server_addr.sin_port = htons(backend->port);
+    inet_pton(AF_INET, backend->ip.c_str(), &server_addr.sin_addr);
+
+    conn->backend.fd = sock;
+    conn->state = ConnState::CONNECTING;
+
+    if (connect(sock, (struct sockaddr *)&server_addr, sizeof(server_addr)) == 0)
+    {
+        on_backend_connected(conn);
+        return;
+    }
+    if (errno != EINPROGRESS)
+    {
+        cerr << "[LB] Failed to connect to backend " << backend->id << endl;
+        fail(conn, "Backend unavailable");
+        return;
+    }
+
+    refresh_interest(conn);
+}
+
+void LBReactor::on_backend_connected(Connection *conn)
+{
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if (getsockopt(conn->backend.fd, SOL_SOCKET, SO_ERROR, &err, &len) < 0 || err != 0)
+    {
+        cerr << "[LB] Failed to connect to backend " << conn->selected->id << endl;
+        fail(conn, "Backend unavailable");
+        return;
+    }
+
+    conn->state = ConnState::RELAYING;
+}
+
+// Fails a PUT whose body hits an END line before its SIZE; the backend
+// would otherwise store the short file.
+bool LBReactor::scan_request_body(Connection *conn, const char *data, size_t len)
+{
+    size_t file_bytes = min(len, conn->body_unscanned);
+    conn->body_unscanned -= file_bytes;
+    if (conn->early_end.feed(data, file_bytes))
+    {
+        fail(conn, "Body shorter than SIZE");
+        return false;
+    }
+    return true;
+}
+
+bool LBReactor::forward_upstream(Connection *conn)
+{
+    while (conn->preamble_sent < conn->preamble.size())
+    {
+        ssize_t sent = send(conn->backend.fd, conn->preamble.data() + conn->preamble_sent,
+                            conn->preamble.size() - conn->preamble_sent, MSG_NOSIGNAL);
+        if (sent > 0)
+        {
+            conn->preamble_sent += sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        return sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    }
+
+    if (conn->upstream.pending() > 0 && !drain(conn->backend, conn->upstream))
+    {
+        if (!conn->backend.eof)
+        {
+            return false;
+        }
+        conn->upstream.start = conn->upstream.end = 0;
+    }
+    return true;
+}
+
+void LBReactor::pump(Connection *conn)
+{
+    if (conn->state == ConnState::RELAYING)
+    {
+        if (!forward_upstream(conn))
+        {
+            release(conn);
+            return;
+        }
+        if (conn->downstream.pending() > 0 && !drain(conn->client, conn->downstream))
+        {
+            release(conn);
+            return;
+        }
+
+        if (conn->downstream.pending() == 0)
+        {
+            if (conn->response.done())
+            {
+                bool request_sent = (conn->request_remaining == 0 &&
+                                     conn->upstream.pending() == 0 &&
+                                     conn->preamble_sent == conn->preamble.size());
+                conn->backend_reusable = (request_sent && conn->response.ok && !conn->backend.eof);
+                finish(conn, conn->response.ok);
+                return;
+            }
+            if (conn->backend.eof)
+            {
+                finish(conn, false);
+                return;
+            }
+        }
+        if (conn->client.eof && conn->request_remaining > 0)
+        {
+            release(conn);
+            return;
+        }
+    }
+    else if (conn->state == ConnState::READ_HEADER && conn->client.eof)
+    {
+        release(conn);
+        return;
+    }
+
+    refresh_interest(conn);
+}
+
+void LBReactor::update_interest(Endpoint &ep, uint32_t interest)
+{
+    if (ep.fd < 0 || (ep.registered && ep.interest == interest))
+    {
+        return;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = interest;
+    ev.data.ptr = &ep;
+
+    int op = ep.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(epoll_fd, op, ep.fd, &ev) == 0)
+    {
+        ep.registered = true;
+        ep.interest = interest;
+    }
+}
+
+void LBReactor::refresh_interest(Connection *conn)
+{
+    bool reading_header = (conn->state == ConnState::READ_HEADER);
+    uint32_t client_interest = 0;
+    if (!conn->client.eof && conn->upstream.space() > 0 &&
+        (reading_header || conn->request_remaining > 0))
+    {
+        client_interest |= EPOLLIN;
+    }
+    if (conn->downstream.pending() > 0)
+    {
+        client_interest |= EPOLLOUT;
+    }
+    update_interest(conn->client, client_interest);
+
+    if (conn->backend.fd < 0)
+    {
+        return;
+    }
+
+    uint32_t backend_interest = 0;
+    if (conn->state == ConnState::CONNECTING)
+    {
+        backend_interest = EPOLLOUT;
+    }
+    else
+    {
+        if (!conn->backend.eof && conn->downstream.space() > 0)
+        {
+            backend_interest |= EPOLLIN;
+        }
+        if (conn->upstream.pending() > 0 || conn->preamble_sent < conn->preamble.size())
+        {
+            backend_interest |= EPOLLOUT;
+        }
+    }
+    update_interest(conn->backend, backend_interest);
+}
+
+void LBReactor::fail(Connection *conn, const string &message)
+{
+    string line = PROTOCOL_ERROR + " " + message + "\n";
+    send(conn->client.fd, line.c_str(), line.size(), MSG_NOSIGNAL);
+    release(conn);
+}
+
+void LBReactor::finish(Connection *conn, bool success)
+{
+    long long now = get_current_time_ns();
+    double response_time_ms = ns_to_ms(now - conn->start_ns);
+    string req_type = (conn->type == RequestType::PUT ? "PUT" : "GET");
+    if (conn->type == RequestType::GET)
+    {
+        conn->file_size = conn->response.body_size;
+    }
+    logger(req_type, conn->selected->id, response_time_ms, conn->file_size);
+
+    if (success)
+    {
+        lb_algo->record_size(conn->filename, conn->file_size, *conn->selected);
+        record_latency(*conn->selected, ns_to_ms(now - conn->selected_ns));
+        cout << "[LB] Successfully forwarded " << req_type << " " << conn->filename
+             << " via backend " << conn->selected->id
+             << " (took " << response_time_ms << " ms)" << endl;
+    }
+    else
+    {
+        cerr << "[LB] Failed to forward " << req_type << " request" << endl;
+    }
+
+    release(conn);
+}
+
+void LBReactor::release(Connection *conn)
+{
+    if (conn->closed)
+    {
+        return;
+    }
+    conn->closed = true;
+
+    close(conn->client.fd);
+    if (conn->backend.fd >= 0)
+    {
+        if (pool && conn->backend_reusable)
+        {
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->backend.fd, nullptr);
+            pool->release(*conn->selected, conn->backend.fd, true);
+        }
+        else
+        {
+            close(conn->backend.fd);
+        }
+    }
+
+    if (conn->selected)
+    {
+        conn->selected->in_flight.fetch_sub(1, memory_order_relaxed);
+    }
+    live.erase(conn);
+    active_connections--;
+    closing.push_back(conn);
+}
@@ -0,0 +1,160 @@
+#ifndef LB_REACTOR_H
+#define LB_REACTOR_H
+
+#include "lb_algorithm.h"
+#include "backend_pool.h"
+#include "protocol.h"
+#include <atomic>
+#include <functional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <sys/epoll.h>
+
+using namespace std;
+
+using RequestLogger = function<void(const string &, int, double, size_t)>;
+
+// Spots an END line inside a SIZE-framed body. Peers end a body at the
+// first END line, so one that comes before the declared size means the
+// body is short and byte-count framing would wait forever.
+struct EarlyEndDetector {
+    size_t line_length = 0;
+    bool matches_end = true;
+
+    bool feed(const char *data, size_t len);
+};
+
+// Tracks where a backend response ends so the backend connection can be
+// reused: a status line, then for a successful GET a SIZE line and
+// SIZE bytes of file data followed by the END line.
+struct ResponseFramer {
+    enum class Phase {
+        STATUS,
+        SIZE,
+        BODY,
+        DONE,
+        UNFRAMED,
+        FAILED
+    };
+
+    static const size_t MAX_LINE = 256;
+
+    Phase phase = Phase::STATUS;
+    bool expect_body = false;
+    bool ok = false;
+    string line;
+    size_t body_size = 0;
+    size_t body_remaining = 0;
+    EarlyEndDetector early_end;
+
+    size_t feed(const char *data, size_t len);
+    bool done() const { return phase == Phase::DONE; }
+    bool failed() const { return phase == Phase::FAILED; }
+};
+
+// Single-threaded epoll event loop. Several loops may share one listening
+// socket; each accepted connection stays on the loop that accepted it.
+class LBReactor {
+private:
+    static const size_t RELAY_BUFFER_SIZE = 16 * 1024;
+    static const int MAX_EVENTS = 256;
+    // A connection with no progress on either side for this long is
+    // failed, checked every SWEEP_INTERVAL_MS.
+    static const long long IDLE_TIMEOUT_MS = 30000;
+    static const long long SWEEP_INTERVAL_MS = 1000;
+
+    enum class ConnState {
+        READ_HEADER,
+        CONNECTING,
+        RELAYING
+    };
+
+    struct Connection;
+
+    struct Endpoint {
+        Connection *conn;
+        int fd;
+        uint32_t interest;
+        bool registered;
+        bool eof;
+    };
+
+    struct RelayBuffer {
+        char data[RELAY_BUFFER_SIZE];
+        size_t start = 0;
+        size_t end = 0;
+
+        size_t pending() const { return end - start; }
+        size_t space() const { return RELAY_BUFFER_SIZE - end; }
+        void compact();
+    };
+
+    struct Connection {
+        Endpoint client;
+        Endpoint backend;
+        ConnState state;
+        RequestType type;
+        string filename;
+        size_t file_size;
+        BackendServer *selected;
+        long long start_ns;
+        long long selected_ns;
+        long long last_active_ns;
+        bool backend_reusable;
+        bool closed;
+
+        string preamble;
+        size_t preamble_sent;
+        size_t request_remaining;
+        size_t body_unscanned;
+        EarlyEndDetector early_end;
+        ResponseFramer response;
+
+        RelayBuffer upstream;
+        RelayBuffer downstream;
+    };
+
+    int listen_fd;
+    int epoll_fd;
+    LBAlgorithm *lb_algo;
+    BackendPool *pool;
+    atomic<bool> &shutdown;
+    RequestLogger logger;
+
+    vector<Connection *> closing;
+    unordered_set<Connection *> live;
+    size_t active_connections;
+    long long last_sweep_ns;
+
+    void accept_connections();
+    void expire_idle(long long now);
+    void handle_event(Endpoint *ep, uint32_t events);
+
+    bool parse_header(Connection *conn);
+    void start_backend_connect(Connection *conn);
+    void on_backend_connected(Connection *conn);
+    void pump(Connection *conn);
+    bool forward_upstream(Connection *conn);
+    bool scan_request_body(Connection *conn, const char *data, size_t len);
+
+    ssize_t fill(Endpoint &from, RelayBuffer &buf, size_t limit);
+    bool drain(Endpoint &to, RelayBuffer &buf);
+
+    void update_interest(Endpoint &ep, uint32_t interest);
+    void refresh_interest(Connection *conn);
+    void fail(Connection *conn, const string &message);
+    void finish(Connection *conn, bool success);
+    void release(Connection *conn);
+
+public:
+    LBReactor(int listen_sock, LBAlgorithm *algo, BackendPool *backend_pool,
+              atomic<bool> &shutdown_flag, RequestLogger request_logger);
+    ~LBReactor();
+
+    void run();
+};
+
+bool set_nonblocking(int fd);
+
+#endif
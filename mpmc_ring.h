@@ -0,0 +1,119 @@
+#ifndef MPMC_RING_H
+#define MPMC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+using namespace std;
+
+// Bounded multi-producer/multi-consumer FIFO (Vyukov). Each cell carries a
+// sequence number: a producer may fill cell i when seq == pos, a consumer
+// may drain it when seq == pos + 1. Capacity is rounded up to a power of
+// two. try_push/try_pop never block; they fail when the ring is full/empty.
+template <typename T>
+class MPMCRing {
+private:
+    struct Cell {
+        atomic<size_t> seq;
+        T value;
+    };
+
+    static const size_t CACHE_LINE = 64;
+
+    unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(CACHE_LINE) atomic<size_t> enqueue_pos;
+    alignas(CACHE_LINE) atomic<size_t> dequeue_pos;
+
+    static size_t round_up(size_t n)
+    {
+        size_t size = 2;
+        while (size < n)
+        {
+            size <<= 1;
+        }
+        return size;
+    }
+
+public:
+    explicit MPMCRing(size_t capacity)
+        : cells(new Cell[round_up(capacity)]), mask(round_up(capacity) - 1),
+          enqueue_pos(0), dequeue_pos(0)
+    {
+        for (size_t i = 0; i <= mask; ++i)
+        {
+            cells[i].seq.store(i, memory_order_relaxed);
+        }
+    }
+
+    MPMCRing(const MPMCRing &) = delete;
+    MPMCRing &operator=(const MPMCRing &) = delete;
+
+    bool try_push(T &&value)
+    {
+        size_t pos = enqueue_pos.load(memory_order_relaxed);
+        while (true)
+        {
+            Cell &cell = cells[pos & mask];
+            size_t seq = cell.seq.load(memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+                {
+                    cell.value = move(value);
+                    cell.seq.store(pos + 1, memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = enqueue_pos.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(T &value)
+    {
+        size_t pos = dequeue_pos.load(memory_order_relaxed);
+        while (true)
+        {
+            Cell &cell = cells[pos & mask];
+            size_t seq = cell.seq.load(memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+                {
+                    value = move(cell.value);
+                    cell.seq.store(pos + mask + 1, memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = dequeue_pos.load(memory_order_relaxed);
+            }
+        }
+    }
+
+    // Approximate; exact only when no push or pop is in progress.
+    bool empty() const
+    {
+        return dequeue_pos.load(memory_order_acquire) >= enqueue_pos.load(memory_order_acquire);
+    }
+
+    size_t capacity() const { return mask + 1; }
+};
+
+#endif
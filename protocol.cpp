@@ -1,9 +1,14 @@
 #include "protocol.h"
 #include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <algorithm>
+#include <charconv>
 #include <cstring>
 #include <iostream>
-#include <sstream>
 
 using namespace std;
 
@@ -25,68 +30,218 @@ bool send_line(int sockfd, const string &message)
   return true;
 }
 
-bool recv_line(int sockfd, string &line)
+ConnectionReader::ConnectionReader(int fd, size_t capacity)
+    : sockfd(fd), buffer(new char[capacity]), capacity(capacity), start(0), end(0),
+      recv_calls(0), max_line(MAX_LINE_LENGTH)
 {
-  line.clear();
-  char c;
+}
 
-  while (true)
+bool ConnectionReader::fill()
+{
+  if (start == end)
   {
-    ssize_t received = recv(sockfd, &c, 1, 0);
-    if (received <= 0)
+    start = end = 0;
+  }
+  else if (end == capacity)
+  {
+    if (start > 0)
+    {
+      memmove(buffer.get(), buffer.get() + start, end - start);
+      end -= start;
+      start = 0;
+    }
+    else if (capacity > max_line)
     {
       return false;
     }
-    if (c == '\n')
+    else
     {
-      break;
+      size_t grown = min(capacity * 2, max_line + 1);
+      unique_ptr<char[]> next(new char[grown]);
+      memcpy(next.get(), buffer.get(), end);
+      buffer = move(next);
+      capacity = grown;
     }
-    line += c;
   }
+
+  ssize_t received = recv(sockfd, buffer.get() + end, capacity - end, 0);
+  recv_calls++;
+  if (received <= 0)
+  {
+    return false;
+  }
+  end += received;
   return true;
 }
 
-bool send_file(int sockfd, const vector<string> &lines, int packet_size)
+bool ConnectionReader::peek_line(string_view &line)
 {
-  size_t i = 0;
-  while (i < lines.size())
+  size_t scanned = 0;
+  while (true)
+  {
+    const char *base = buffer.get() + start;
+    const char *eol = static_cast<const char *>(
+        memchr(base + scanned, '\n', (end - start) - scanned));
+    if (eol)
+    {
+      line = string_view(base, eol - base);
+      return true;
+    }
+    scanned = end - start;
+
+    if (!fill())
+    {
+      return false;
+    }
+  }
+}
+
+bool ConnectionReader::read_line(string_view &line)
+{
+  if (!peek_line(line))
+  {
+    return false;
+  }
+  start += line.size() + 1;
+  return true;
+}
+
+string_view ConnectionReader::take(size_t max_bytes)
+{
+  if (start == end && !fill())
+  {
+    return string_view();
+  }
+  size_t n = min(max_bytes, end - start);
+  string_view data(buffer.get() + start, n);
+  start += n;
+  return data;
+}
+
+bool recv_line(ConnectionReader &reader, string &line)
+{
+  string_view view;
+  if (!reader.read_line(view))
+  {
+    line.clear();
+    return false;
+  }
+  line.assign(view);
+  return true;
+}
+
+static const string END_LINE = PROTOCOL_END + "\n";
+
+// Upper bound on what recv_file preallocates from an untrusted SIZE line.
+static const size_t RECV_RESERVE_LIMIT = 64 * 1024 * 1024;
+
+bool send_iov(int sockfd, struct iovec *iov, size_t count)
+{
+  while (count > 0)
   {
-    string packet;
-    size_t end = min(i + packet_size, lines.size());
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = count;
 
-    for (size_t j = i; j < end; ++j)
+    ssize_t sent = sendmsg(sockfd, &msg, MSG_NOSIGNAL);
+    if (sent <= 0)
+    {
+      return false;
+    }
+
+    while (count > 0 && static_cast<size_t>(sent) >= iov->iov_len)
+    {
+      sent -= iov->iov_len;
+      ++iov;
+      --count;
+    }
+    if (count > 0)
+    {
+      iov->iov_base = static_cast<char *>(iov->iov_base) + sent;
+      iov->iov_len -= sent;
+    }
+  }
+  return true;
+}
+
+bool send_bytes(int sockfd, string_view data)
+{
+  size_t total_sent = 0;
+  while (total_sent < data.size())
+  {
+    ssize_t sent = send(sockfd, data.data() + total_sent, data.size() - total_sent,
+                        MSG_NOSIGNAL);
+    if (sent <= 0)
     {
-      packet += lines[j] + "\n";
+      return false;
     }
+    total_sent += sent;
+  }
+  return true;
+}
 
-    ssize_t total_sent = 0;
-    ssize_t len = packet.length();
+bool send_file(int sockfd, const FileBlob &file, const Packetization &packet)
+{
+  string_view bytes = file.bytes();
+  size_t max_bytes = max<size_t>(packet.max_bytes, 1);
 
-    while (total_sent < len)
+  size_t pos = 0;
+  size_t line = 0;
+  do
+  {
+    size_t end = pos + min(max_bytes, bytes.size() - pos);
+    if (packet.max_lines > 0)
     {
-      ssize_t sent = send(sockfd, packet.c_str() + total_sent, len - total_sent, 0);
-      if (sent <= 0)
+      size_t line_end = min(line + packet.max_lines, file.line_count());
+      if (file.line_offset(line_end) <= end)
       {
-        return false;
+        end = file.line_offset(line_end);
+        line = line_end;
+      }
+      else
+      {
+        line = file.line_at_offset(end);
       }
-      total_sent += sent;
     }
 
-    i = end;
-  }
+    if (!send_file_range(sockfd, file, pos, end))
+    {
+      return false;
+    }
+    pos = end;
+  } while (pos < bytes.size());
 
-  return send_line(sockfd, PROTOCOL_END);
+  return true;
 }
 
-bool recv_file(int sockfd, size_t size, vector<string> &lines)
+bool send_file_range(int sockfd, const FileBlob &file, size_t begin, size_t end)
 {
-  lines.clear();
+  string_view bytes = file.bytes();
+  struct iovec iov[2];
+  size_t count = 0;
+  iov[count].iov_base = const_cast<char *>(bytes.data() + begin);
+  iov[count].iov_len = end - begin;
+  ++count;
+  if (end == bytes.size())
+  {
+    iov[count].iov_base = const_cast<char *>(END_LINE.data());
+    iov[count].iov_len = END_LINE.size();
+    ++count;
+  }
+  return send_iov(sockfd, iov, count);
+}
+
+static bool recv_file_lines(ConnectionReader &reader, size_t size, FileBlob &file)
+{
+  file.clear();
+  file.reserve(min(size, RECV_RESERVE_LIMIT), 0);
   size_t received = 0;
+  string_view line;
 
   while (received < size)
   {
-    string line;
-    if (!recv_line(sockfd, line))
+    if (!reader.read_line(line))
     {
       return false;
     }
@@ -96,58 +251,378 @@ bool recv_file(int sockfd, size_t size, vector<string> &lines)
       break;
     }
 
-    lines.push_back(line);
+    file.append_line(line);
     received += line.length() + 1;
+
+    if (received >= size)
+    {
+      return reader.read_line(line) && line == PROTOCOL_END;
+    }
+  }
+
+  if (size == 0)
+  {
+    return reader.read_line(line) && line == PROTOCOL_END;
   }
 
   return true;
 }
 
-bool parse_request(int sockfd, Request &request)
+bool recv_file(ConnectionReader &reader, size_t size, FileBlob &file)
+{
+  // A body line may be as long as the file; the header limit comes back
+  // for the next message.
+  size_t header_limit = reader.max_line_length();
+  reader.set_max_line_length(max(header_limit, size));
+  bool received = recv_file_lines(reader, size, file);
+  reader.set_max_line_length(header_limit);
+  return received;
+}
+
+static string_view next_token(string_view &rest)
+{
+  size_t begin = rest.find_first_not_of(" \t\r");
+  if (begin == string_view::npos)
+  {
+    rest = string_view();
+    return rest;
+  }
+  rest.remove_prefix(begin);
+
+  string_view token = rest.substr(0, rest.find_first_of(" \t\r"));
+  rest.remove_prefix(token.size());
+  return token;
+}
+
+bool parse_size_line(string_view line, size_t &size)
+{
+  if (next_token(line) != PROTOCOL_SIZE)
+  {
+    return false;
+  }
+
+  string_view digits = next_token(line);
+  auto result = from_chars(digits.data(), digits.data() + digits.size(), size);
+  return result.ec == errc() && result.ptr == digits.data() + digits.size() &&
+         !digits.empty();
+}
+
+bool parse_deadline_line(string_view line, long long &deadline_ms)
 {
-  string command;
-  if (!recv_line(sockfd, command))
+  if (next_token(line) != PROTOCOL_DEADLINE)
   {
     return false;
   }
 
-  istringstream iss(command);
-  string cmd, filename;
-  iss >> cmd >> filename;
+  string_view digits = next_token(line);
+  auto result = from_chars(digits.data(), digits.data() + digits.size(), deadline_ms);
+  return result.ec == errc() && result.ptr == digits.data() + digits.size() &&
+         !digits.empty() && deadline_ms > 0;
+}
+
+bool parse_client_line(string_view line, string &client_key)
+{
+  if (next_token(line) != PROTOCOL_CLIENT)
+  {
+    return false;
+  }
+
+  string_view id = next_token(line);
+  if (id.empty())
+  {
+    return false;
+  }
+  client_key.assign(id);
+  return true;
+}
+
+string peer_address(int sockfd)
+{
+  struct sockaddr_in addr;
+  socklen_t len = sizeof(addr);
+  char text[INET_ADDRSTRLEN];
+  if (getpeername(sockfd, (struct sockaddr *)&addr, &len) < 0 || addr.sin_family != AF_INET ||
+      !inet_ntop(AF_INET, &addr.sin_addr, text, sizeof(text)))
+  {
+    return string();
+  }
+  return text;
+}
+
+// KEEPALIVE, DEADLINE and CLIENT lines may precede the command.
+static bool parse_option_line(string_view line, Request &request)
+{
+  if (line == PROTOCOL_KEEPALIVE)
+  {
+    request.keep_alive = true;
+    return true;
+  }
+  return parse_deadline_line(line, request.deadline_ms) ||
+         parse_client_line(line, request.client_key);
+}
+
+bool parse_request_header(ConnectionReader &reader, Request &request)
+{
+  string_view command;
+  if (!reader.read_line(command))
+  {
+    return false;
+  }
+
+  while (parse_option_line(command, request))
+  {
+    if (!reader.read_line(command))
+    {
+      return false;
+    }
+  }
+
+  string_view cmd = next_token(command);
+  string_view filename = next_token(command);
 
   if (cmd == PROTOCOL_PUT)
   {
     request.type = RequestType::PUT;
-    request.filename = filename;
+    request.filename.assign(filename);
 
-    string size_line;
-    if (!recv_line(sockfd, size_line))
+    string_view size_line;
+    if (!reader.read_line(size_line))
     {
       return false;
     }
 
-    istringstream size_iss(size_line);
-    string size_cmd;
-    size_iss >> size_cmd >> request.file_size;
+    return parse_size_line(size_line, request.file_size);
+  }
+  else if (cmd == PROTOCOL_GET)
+  {
+    request.type = RequestType::GET;
+    request.filename.assign(filename);
+    return true;
+  }
+
+  return false;
+}
 
-    if (size_cmd != PROTOCOL_SIZE)
+bool parse_request(ConnectionReader &reader, Request &request)
+{
+  if (!parse_request_header(reader, request))
+  {
+    return false;
+  }
+
+  if (request.type == RequestType::PUT)
+  {
+    auto file = make_shared<FileBlob>();
+    if (!recv_file(reader, request.file_size, *file))
     {
       return false;
     }
+    request.file_data = move(file);
+  }
+  return true;
+}
+
+RequestFramer::RequestFramer()
+    : phase(Phase::COMMAND), health(false), bytes_seen(0), body_received(0),
+      request(make_shared<Request>())
+{
+}
+
+size_t RequestFramer::feed(const char *data, size_t len)
+{
+  size_t i = 0;
+  while (i < len && phase != Phase::DONE && phase != Phase::FAILED)
+  {
+    const char *eol = static_cast<const char *>(memchr(data + i, '\n', len - i));
+    size_t take = eol ? static_cast<size_t>(eol - (data + i)) : len - i;
+
+    if (!eol)
+    {
+      partial.append(data + i, take);
+      i = len;
+      size_t limit = (phase == Phase::BODY)
+                         ? max(MAX_HEADER_LINE, request->file_size - body_received)
+                         : MAX_HEADER_LINE;
+      if (partial.size() > limit)
+      {
+        phase = Phase::FAILED;
+      }
+      break;
+    }
+
+    if (partial.empty())
+    {
+      on_line(string_view(data + i, take));
+    }
+    else
+    {
+      partial.append(data + i, take);
+      on_line(partial);
+      partial.clear();
+    }
+    i += take + 1;
+  }
+
+  bytes_seen += i;
+  return i;
+}
+
+void RequestFramer::on_line(string_view line)
+{
+  switch (phase)
+  {
+  case Phase::COMMAND:
+  {
+    if (line == PROTOCOL_HEALTH)
+    {
+      health = true;
+      phase = Phase::DONE;
+      return;
+    }
+    if (parse_option_line(line, *request))
+    {
+      return;
+    }
 
-    if (!recv_file(sockfd, request.file_size, request.file_lines))
+    string_view cmd = next_token(line);
+    request->filename.assign(next_token(line));
+    if (cmd == PROTOCOL_PUT)
+    {
+      request->type = RequestType::PUT;
+      phase = Phase::SIZE;
+    }
+    else if (cmd == PROTOCOL_GET)
+    {
+      request->type = RequestType::GET;
+      phase = Phase::DONE;
+    }
+    else
+    {
+      phase = Phase::FAILED;
+    }
+    return;
+  }
+  case Phase::SIZE:
+    if (!parse_size_line(line, request->file_size))
+    {
+      phase = Phase::FAILED;
+      return;
+    }
+    body = make_shared<FileBlob>();
+    body->reserve(min(request->file_size, RECV_RESERVE_LIMIT), 0);
+    phase = request->file_size == 0 ? Phase::END : Phase::BODY;
+    return;
+  case Phase::BODY:
+    if (line == PROTOCOL_END)
+    {
+      phase = Phase::DONE;
+      return;
+    }
+    body->append_line(line);
+    body_received += line.size() + 1;
+    if (body_received >= request->file_size)
+    {
+      phase = Phase::END;
+    }
+    return;
+  case Phase::END:
+    phase = (line == PROTOCOL_END) ? Phase::DONE : Phase::FAILED;
+    return;
+  default:
+    return;
+  }
+}
+
+shared_ptr<Request> RequestFramer::take_request()
+{
+  if (request->type == RequestType::PUT)
+  {
+    request->file_data = move(body);
+  }
+  return move(request);
+}
+
+static bool pump_bytes(int from_fd, int to_fd, size_t len)
+{
+  char buffer[RELAY_CHUNK_SIZE];
+  while (len > 0)
+  {
+    ssize_t received = recv(from_fd, buffer, min(len, sizeof(buffer)), 0);
+    if (received <= 0)
     {
       return false;
     }
 
-    return true;
+    if (!send_bytes(to_fd, string_view(buffer, received)))
+    {
+      return false;
+    }
+    len -= received;
   }
-  else if (cmd == PROTOCOL_GET)
+  return true;
+}
+
+bool relay_bytes(ConnectionReader &from, int to_fd, size_t len)
+{
+  while (len > 0 && from.buffered() > 0)
+  {
+    string_view chunk = from.take(len);
+    if (!send_bytes(to_fd, chunk))
+    {
+      return false;
+    }
+    len -= chunk.size();
+  }
+  if (len == 0)
   {
-    request.type = RequestType::GET;
-    request.filename = filename;
     return true;
   }
 
-  return false;
-}
\ No newline at end of file
+  int from_fd = from.fd();
+  int pipefd[2];
+  if (pipe2(pipefd, O_CLOEXEC) < 0)
+  {
+    return pump_bytes(from_fd, to_fd, len);
+  }
+
+  bool ok = true;
+  bool first = true;
+  while (len > 0)
+  {
+    ssize_t in_pipe = splice(from_fd, nullptr, pipefd[1], nullptr,
+                             min(len, RELAY_CHUNK_SIZE), SPLICE_F_MOVE);
+    if (in_pipe < 0 && first && errno == EINVAL)
+    {
+      close(pipefd[0]);
+      close(pipefd[1]);
+      return pump_bytes(from_fd, to_fd, len);
+    }
+    if (in_pipe <= 0)
+    {
+      ok = false;
+      break;
+    }
+    first = false;
+    len -= in_pipe;
+
+    unsigned int flags = SPLICE_F_MOVE | (len > 0 ? SPLICE_F_MORE : 0);
+    while (in_pipe > 0)
+    {
+      ssize_t out = splice(pipefd[0], nullptr, to_fd, nullptr, in_pipe, flags);
+      if (out <= 0)
+      {
+        ok = false;
+        break;
+      }
+      in_pipe -= out;
+    }
+    if (!ok)
+    {
+      break;
+    }
+  }
+
+  close(pipefd[0]);
+  close(pipefd[1]);
+  return ok;
+}
@@ -1,7 +1,10 @@
 #ifndef PROTOCOL_H
 #define PROTOCOL_H
 
+#include "file_blob.h"
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 using namespace std;
@@ -16,6 +19,25 @@ const string PROTOCOL_END = "END";
 const string PROTOCOL_HEALTH = "HEALTH";
 const string PROTOCOL_HEALTH_OK = "HEALTH_OK";
 
+const string PROTOCOL_KEEPALIVE = "KEEPALIVE";
+
+// Optional line before PUT/GET: "DEADLINE <ms>" asks the backend to finish
+// the request within ms of receiving it.
+const string PROTOCOL_DEADLINE = "DEADLINE";
+
+// Optional line before PUT/GET: "CLIENT <id>" names the flow the request
+// belongs to for fair queuing. The LB adds the client's address when the
+// client sends none.
+const string PROTOCOL_CLIENT = "CLIENT";
+
+const size_t RELAY_CHUNK_SIZE = 64 * 1024;
+const size_t READER_BUFFER_SIZE = 64 * 1024;
+// Longest header line a reader or framer accepts, newline excluded; longer
+// lines fail the read instead of growing the buffer without bound. Body
+// lines may be as long as the declared SIZE.
+const size_t MAX_LINE_LENGTH = READER_BUFFER_SIZE;
+const size_t DEFAULT_PACKET_BYTES = 64 * 1024;
+
 enum class RequestType {
     PUT,
     GET,
@@ -26,7 +48,7 @@ struct Request {
     RequestType type;
     string filename;
     size_t file_size;
-    vector<string> file_lines;
+    shared_ptr<const FileBlob> file_data;
     int client_id;
 
     long long arrival_time;
@@ -34,19 +56,135 @@ struct Request {
     long long finish_time;
 
     size_t lines_processed = 0;
+    bool keep_alive = false;
+
+    // Relative to arrival_time; 0 means no deadline.
+    long long deadline_ms = 0;
+    bool dropped = false;
+
+    // Fair-queuing flow; empty until a CLIENT line or the peer address sets it.
+    string client_key;
+
+    // Set by schedulers that track per-level queueing (MLFQ).
+    int priority_level = 0;
+    long long queued_time = 0;
 
     Request() : type(RequestType::UNKNOWN), file_size(0), client_id(0),
                 arrival_time(0), start_time(0), finish_time(0) {}
 };
 
+// Buffered reader over one connection. Reads in READER_BUFFER_SIZE chunks
+// and hands out lines as views into its buffer; a view stays valid until
+// the next call on the reader. Bytes buffered past the current message are
+// kept for the next read, so use one reader per connection for its whole
+// lifetime instead of mixing it with direct recv() calls.
+class ConnectionReader {
+private:
+    int sockfd;
+    // Left uninitialized; only [start, end) is ever read.
+    unique_ptr<char[]> buffer;
+    size_t capacity;
+    size_t start;
+    size_t end;
+    size_t recv_calls;
+    size_t max_line;
+
+    bool fill();
+
+public:
+    explicit ConnectionReader(int fd, size_t capacity = READER_BUFFER_SIZE);
+
+    // Longest line the reader will buffer (MAX_LINE_LENGTH by default).
+    size_t max_line_length() const { return max_line; }
+    void set_max_line_length(size_t bytes) { max_line = bytes; }
+
+    bool peek_line(string_view& line);
+    bool read_line(string_view& line);
+    string_view take(size_t max_bytes);
+
+    int fd() const { return sockfd; }
+    size_t buffered() const { return end - start; }
+    size_t syscalls() const { return recv_calls; }
+};
+
+// How send_file splits a file into sendmsg() calls: a packet closes once it
+// reaches max_bytes, or max_lines lines when that is non-zero (--p).
+struct Packetization {
+    size_t max_bytes = DEFAULT_PACKET_BYTES;
+    size_t max_lines = 0;
+};
+
+struct iovec;
+
+// Incremental request parser for non-blocking connections. feed() takes
+// bytes as they arrive and stops consuming once a whole request (command,
+// SIZE and body for a PUT) has been framed; the request is then in
+// request(). A HEALTH probe frames as an empty request with is_health().
+class RequestFramer {
+public:
+    enum class Phase {
+        COMMAND,
+        SIZE,
+        BODY,
+        END,
+        DONE,
+        FAILED
+    };
+
+    static const size_t MAX_HEADER_LINE = 4096;
+
+    RequestFramer();
+
+    size_t feed(const char* data, size_t len);
+
+    bool started() const { return bytes_seen > 0; }
+    bool done() const { return phase == Phase::DONE; }
+    bool failed() const { return phase == Phase::FAILED; }
+    bool is_health() const { return health; }
+    shared_ptr<Request> take_request();
+
+private:
+    Phase phase;
+    bool health;
+    size_t bytes_seen;
+    size_t body_received;
+    string partial;
+    shared_ptr<Request> request;
+    shared_ptr<FileBlob> body;
+
+    void on_line(string_view line);
+};
+
 bool send_line(int sockfd, const string& message);
 
-bool recv_line(int sockfd, string& line);
+bool send_iov(int sockfd, struct iovec* iov, size_t count);
+
+bool send_bytes(int sockfd, string_view data);
+
+bool recv_line(ConnectionReader& reader, string& line);
+
+bool send_file(int sockfd, const FileBlob& file,
+               const Packetization& packet = Packetization());
+
+// Sends file bytes [begin, end) in one sendmsg(), with END appended when
+// end is the end of the file.
+bool send_file_range(int sockfd, const FileBlob& file, size_t begin, size_t end);
+
+bool recv_file(ConnectionReader& reader, size_t size, FileBlob& file);
+
+bool parse_size_line(string_view line, size_t& size);
+
+bool parse_deadline_line(string_view line, long long& deadline_ms);
+
+bool parse_client_line(string_view line, string& client_key);
+
+// IPv4 address of the socket's peer, or "" if it has none.
+string peer_address(int sockfd);
 
-bool send_file(int sockfd, const vector<string>& lines, int packet_size);
+bool parse_request(ConnectionReader& reader, Request& request);
 
-bool recv_file(int sockfd, size_t size, vector<string>& lines);
+bool parse_request_header(ConnectionReader& reader, Request& request);
 
-bool parse_request(int sockfd, Request& request);
+bool relay_bytes(ConnectionReader& from, int to_fd, size_t len);
 
 #endif
\ No newline at end of file
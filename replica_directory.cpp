@@ -0,0 +1,120 @@
+#include "replica_directory.h"
+#include <algorithm>
+#include <mutex>
+
+using namespace std;
+
+unsigned long long ReplicaDirectory::start_write(const string &filename)
+{
+    unique_lock<shared_mutex> guard(lock);
+    Entry &entry = entries[filename];
+    unsigned long long generation = ++last_generation;
+    entry.pending[generation];
+    return generation;
+}
+
+static void add_holder(vector<BackendServer *> &copies, BackendServer *backend)
+{
+    if (find(copies.begin(), copies.end(), backend) == copies.end())
+    {
+        copies.push_back(backend);
+    }
+}
+
+void ReplicaDirectory::add(const string &filename, BackendServer *backend,
+                           unsigned long long generation)
+{
+    unique_lock<shared_mutex> guard(lock);
+    auto it = entries.find(filename);
+    if (it == entries.end())
+    {
+        return;
+    }
+    Entry &entry = it->second;
+    auto pending = entry.pending.find(generation);
+    if (pending != entry.pending.end())
+    {
+        add_holder(pending->second, backend);
+    }
+    else if (entry.generation == generation)
+    {
+        add_holder(entry.holders, backend);
+    }
+}
+
+// Replaces the holders with the write's acknowledged replicas, unless a
+// newer write has already been committed. Older writes still in flight can
+// no longer be committed, so they are dropped.
+void ReplicaDirectory::commit(const string &filename, unsigned long long generation)
+{
+    unique_lock<shared_mutex> guard(lock);
+    auto it = entries.find(filename);
+    if (it == entries.end())
+    {
+        return;
+    }
+    Entry &entry = it->second;
+    auto pending = entry.pending.find(generation);
+    if (pending == entry.pending.end() || generation < entry.generation)
+    {
+        return;
+    }
+    entry.generation = generation;
+    entry.holders = move(pending->second);
+    entry.pending.erase(entry.pending.begin(), next(pending));
+}
+
+// The previous holders keep serving GETs. The failed write may have reached
+// some of them, so a GET can return either version of the file, which a
+// client whose PUT was refused has to expect anyway. An entry left with no
+// holders and no writes in flight is forgotten and the file goes back to
+// the algorithm.
+void ReplicaDirectory::abandon(const string &filename, unsigned long long generation)
+{
+    unique_lock<shared_mutex> guard(lock);
+    auto it = entries.find(filename);
+    if (it == entries.end())
+    {
+        return;
+    }
+    Entry &entry = it->second;
+    entry.pending.erase(generation);
+    if (entry.holders.empty() && entry.pending.empty())
+    {
+        entries.erase(it);
+    }
+}
+
+void ReplicaDirectory::remove(const string &filename, BackendServer *backend)
+{
+    unique_lock<shared_mutex> guard(lock);
+    auto it = entries.find(filename);
+    if (it != entries.end())
+    {
+        vector<BackendServer *> &copies = it->second.holders;
+        copies.erase(std::remove(copies.begin(), copies.end(), backend), copies.end());
+    }
+}
+
+vector<BackendServer *> ReplicaDirectory::lookup(const string &filename)
+{
+    shared_lock<shared_mutex> guard(lock);
+    auto it = entries.find(filename);
+    return it == entries.end() ? vector<BackendServer *>() : it->second.holders;
+}
+
+vector<BackendServer *> choose_replicas(vector<BackendServer> &backends, BackendServer *primary,
+                                        size_t count)
+{
+    vector<BackendServer *> replicas = {primary};
+    size_t start = primary - backends.data();
+    for (size_t i = 1; i < backends.size() && replicas.size() < count; ++i)
+    {
+        BackendServer &backend = backends[(start + i) % backends.size()];
+        if (backend.is_healthy())
+        {
+            replicas.push_back(&backend);
+        }
+    }
+    return replicas;
+}
@@ -0,0 +1,63 @@
+#ifndef REPLICA_DIRECTORY_H
+#define REPLICA_DIRECTORY_H
+
+#include "lb_config.h"
+#include <atomic>
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+struct ReplicationStats {
+    atomic<long long> writes{0};
+    atomic<long long> quorum_failures{0};
+    atomic<long long> replica_failures{0};
+    atomic<long long> replicated_reads{0};
+    atomic<long long> read_failovers{0};
+};
+
+// Which backends hold a copy of each file the LB replicated (--replicas).
+// A PUT starts a new generation of the file's entry and each replica adds
+// itself to it once it has acknowledged. GETs keep reading the previous
+// generation's holders until the new one reaches its quorum and is
+// committed; after that, late acknowledgements of the committed generation
+// still join it and those of older PUTs are ignored. A PUT that misses its
+// quorum is abandoned and the previous holders stay in use, and a replica
+// that answers a GET with an error is dropped. Files the LB never
+// replicated (e.g. preloaded with --file) have no entry.
+class ReplicaDirectory {
+private:
+    struct Entry {
+        unsigned long long generation = 0;
+        vector<BackendServer *> holders;
+        // Acknowledged replicas of the writes still short of their quorum.
+        map<unsigned long long, vector<BackendServer *>> pending;
+    };
+
+    shared_mutex lock;
+    unordered_map<string, Entry> entries;
+    unsigned long long last_generation = 0;
+    ReplicationStats stats;
+
+public:
+    // Returns the generation to tag the write's add(), commit() and
+    // abandon() calls with. The file's current holders are left in place.
+    unsigned long long start_write(const string &filename);
+    void add(const string &filename, BackendServer *backend, unsigned long long generation);
+    void commit(const string &filename, unsigned long long generation);
+    void abandon(const string &filename, unsigned long long generation);
+    void remove(const string &filename, BackendServer *backend);
+    vector<BackendServer *> lookup(const string &filename);
+
+    ReplicationStats &get_stats() { return stats; }
+};
+
+// Replica set for a new write: primary, then the next healthy backends in
+// config order, count in total (fewer if not enough are healthy).
+vector<BackendServer *> choose_replicas(vector<BackendServer> &backends, BackendServer *primary,
+                                        size_t count);
+
+#endif
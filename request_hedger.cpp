@@ -0,0 +1,74 @@
+#include "request_hedger.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+RequestHedger::RequestHedger(double fixed_delay, double budget_percent)
+    : fixed_delay_ms(fixed_delay),
+      earn_per_request(llround(budget_percent / 100.0 * HEDGE_COST))
+{
+    samples.reserve(SAMPLE_WINDOW);
+}
+
+double RequestHedger::delay_ms() const
+{
+    return tracks_p95() ? tracked_p95_ms.load(memory_order_relaxed) : fixed_delay_ms;
+}
+
+void RequestHedger::on_request()
+{
+    stats.requests.fetch_add(1, memory_order_relaxed);
+    long long current = tokens.load(memory_order_relaxed);
+    long long next;
+    do
+    {
+        next = min(current + earn_per_request, MAX_BURST);
+    } while (!tokens.compare_exchange_weak(current, next, memory_order_relaxed));
+}
+
+bool RequestHedger::try_spend()
+{
+    long long current = tokens.load(memory_order_relaxed);
+    do
+    {
+        if (current < HEDGE_COST)
+        {
+            stats.over_budget.fetch_add(1, memory_order_relaxed);
+            return false;
+        }
+    } while (!tokens.compare_exchange_weak(current, current - HEDGE_COST,
+                                           memory_order_relaxed));
+    stats.hedged.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+void RequestHedger::record_response_ms(double ms)
+{
+    if (!tracks_p95())
+    {
+        return;
+    }
+
+    lock_guard<mutex> lock(samples_lock);
+    if (samples.size() < SAMPLE_WINDOW)
+    {
+        samples.push_back(ms);
+    }
+    else
+    {
+        samples[next_sample] = ms;
+        next_sample = (next_sample + 1) % SAMPLE_WINDOW;
+    }
+
+    if (samples.size() < MIN_SAMPLES || ++since_refresh < REFRESH_EVERY)
+    {
+        return;
+    }
+    since_refresh = 0;
+
+    vector<double> sorted(samples);
+    auto p95 = sorted.begin() + (sorted.size() * 95) / 100;
+    nth_element(sorted.begin(), p95, sorted.end());
+    tracked_p95_ms.store(*p95, memory_order_relaxed);
+}
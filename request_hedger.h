@@ -0,0 +1,58 @@
+#ifndef REQUEST_HEDGER_H
+#define REQUEST_HEDGER_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+struct HedgeStats {
+    atomic<long long> requests{0};
+    atomic<long long> hedged{0};
+    atomic<long long> hedge_wins{0};
+    atomic<long long> over_budget{0};
+};
+
+// Decides when a GET whose backend is slow to answer gets a duplicate sent
+// to a second backend (--hedge-delay). The delay is either fixed or the p95
+// of recent times from sending a GET to its status line. Hedges are paid
+// for from a token bucket that each GET tops up by budget_percent / 100 of
+// a hedge, so hedges stay within that share of GETs plus a small burst.
+class RequestHedger {
+public:
+    static constexpr size_t SAMPLE_WINDOW = 1024;
+    static constexpr size_t MIN_SAMPLES = 64;
+    static constexpr size_t REFRESH_EVERY = 64;
+    static constexpr long long HEDGE_COST = 1000;
+    static constexpr long long MAX_BURST = 10 * HEDGE_COST;
+
+private:
+    double fixed_delay_ms;
+    long long earn_per_request;
+    atomic<long long> tokens{0};
+    atomic<double> tracked_p95_ms{-1.0};
+
+    mutex samples_lock;
+    vector<double> samples;
+    size_t next_sample = 0;
+    size_t since_refresh = 0;
+
+    HedgeStats stats;
+
+public:
+    // fixed_delay_ms <= 0 tracks the p95 instead.
+    RequestHedger(double fixed_delay_ms, double budget_percent);
+
+    // Negative until the p95 window has MIN_SAMPLES samples.
+    double delay_ms() const;
+    bool tracks_p95() const { return fixed_delay_ms <= 0; }
+
+    void on_request();
+    bool try_spend();
+    void record_response_ms(double ms);
+
+    HedgeStats &get_stats() { return stats; }
+};
+
+#endif
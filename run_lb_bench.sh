@@ -0,0 +1,119 @@
+#!/bin/bash
+GREEN='\033[0;32m'
+RED='\033[0;31m'
+NC='\033[0m'
+
+LB_BIN="./lb"
+BENCH_BIN="./bench"
+RESULTS_DIR="results_lb"
+OUT_FILE="$RESULTS_DIR/lb_mode_bench.csv"
+STORM_FILE="$RESULTS_DIR/lb_storm_bench.csv"
+
+MODES=${MODES:-"thread reactor"}
+CONCURRENCY=${CONCURRENCY:-"8 64 512 2048 10000"}
+DURATION=${DURATION:-10}
+FILE=${FILE:-small_1.txt}
+LARGE_FILE=${LARGE_FILE:-xlarge_1.txt}
+RELAY_CONCURRENCY=${RELAY_CONCURRENCY:-64}
+STORM_LOOPS=${STORM_LOOPS:-"1 2 4 $(nproc)"}
+STORM_REQUEST=${STORM_REQUEST:-"PING"}
+
+print_msg() {
+    echo -e "${GREEN}[BENCH]${NC} $1"
+}
+
+print_error() {
+    echo -e "${RED}[ERROR]${NC} $1"
+}
+
+if [ ! -f "$LB_BIN" ] || [ ! -f "$BENCH_BIN" ]; then
+    print_error "lb/bench binaries not found. Run 'make' first."
+    exit 1
+fi
+
+ulimit -n 65536 2>/dev/null || print_error "Could not raise open file limit"
+
+cleanup() {
+    ./stop_backends.sh > /dev/null 2>&1 || true
+    pkill -9 -x lb 2>/dev/null || true
+    sleep 1
+}
+
+mkdir -p $RESULTS_DIR
+cleanup
+
+./start_backends.sh > /dev/null 2>&1
+sleep 3
+
+echo "mode,lb_args,conns,requests,errors,error_replies,throughput_rps,p50_ms,p99_ms,p999_ms,ttfb_p50_ms,ttfb_p99_ms,lb_peak_rss_kb,lb_threads" > $OUT_FILE
+
+run_point() {
+    local mode=$1
+    local conns=$2
+    shift 2
+    local lb_args="$*"
+
+    $LB_BIN --algo rr --config config_lb.json $lb_args > /dev/null 2>&1 &
+    local lb_pid=$!
+    sleep 2
+
+    local threads_peak=0
+    (
+        while kill -0 $lb_pid 2>/dev/null; do
+            grep Threads /proc/$lb_pid/status 2>/dev/null | awk '{print $2}'
+            sleep 0.5
+        done
+    ) > /tmp/lb_threads.$$ &
+    local sampler=$!
+
+    local result
+    result=$($BENCH_BIN load --port 8000 --conns $conns --threads 8 \
+        --duration $DURATION --file $FILE | tail -1)
+
+    local rss
+    rss=$(grep VmHWM /proc/$lb_pid/status | awk '{print $2}')
+
+    kill -INT $lb_pid 2>/dev/null
+    wait $lb_pid 2>/dev/null
+    kill $sampler 2>/dev/null
+    threads_peak=$(sort -n /tmp/lb_threads.$$ | tail -1)
+    rm -f /tmp/lb_threads.$$
+
+    echo "$mode,\"$lb_args\",$result,$rss,$threads_peak" >> $OUT_FILE
+    print_msg "$mode conns=$conns -> $result rss=${rss}kB threads=$threads_peak"
+    sleep 1
+}
+
+for conns in $CONCURRENCY; do
+    for mode in $MODES; do
+        run_point $mode $conns --mode $mode
+    done
+done
+
+# Copy vs streaming relay for large GETs (thread mode)
+for relay in copy stream; do
+    FILE=$LARGE_FILE run_point thread-$relay $RELAY_CONCURRENCY --mode thread --relay $relay
+done
+
+echo "mode,loops,threads,connections,errors,connections_per_sec" > $STORM_FILE
+
+for mode in reactor sharded; do
+    for loops in $STORM_LOOPS; do
+        $LB_BIN --algo rr --config config_lb.json --mode $mode --loops $loops --pin > /dev/null 2>&1 &
+        lb_pid=$!
+        sleep 2
+
+        result=$($BENCH_BIN storm --port 8000 --threads 64 --duration $DURATION \
+            --request "$STORM_REQUEST" | tail -1)
+
+        kill -INT $lb_pid 2>/dev/null
+        wait $lb_pid 2>/dev/null
+
+        echo "$mode,$loops,$result" >> $STORM_FILE
+        print_msg "storm $mode loops=$loops -> $result"
+        sleep 1
+    done
+done
+
+cleanup
+print_msg "Results saved to $OUT_FILE and $STORM_FILE"
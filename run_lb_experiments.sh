@@ -7,6 +7,7 @@ LB_BIN="./lb"
 CLIENT_BIN="./client"
 TEST_DIR="testdata"
 RESULTS_DIR="results_lb"
+ALGOS="${ALGOS:-rr lrt p2c peak_ewma}"
 
 print_msg() {
     echo -e "${GREEN}[EXPERIMENT]${NC} $1"
@@ -73,18 +74,21 @@ echo ""
 
 print_msg "=== Experiment 1: Algorithm Comparison ==="
 for clients in 4 8 16; do
-    run_experiment "exp1_rr_c${clients}" "rr" $clients 20
-    run_experiment "exp1_lrt_c${clients}" "lrt" $clients 20
+    for algo in $ALGOS; do
+        run_experiment "exp1_${algo}_c${clients}" "$algo" $clients 20
+    done
 done
 
 print_msg "=== Experiment 2: High Load Test ==="
-run_experiment "exp2_rr_stress" "rr" 32 50
-run_experiment "exp2_lrt_stress" "lrt" 32 50
+for algo in $ALGOS; do
+    run_experiment "exp2_${algo}_stress" "$algo" 32 50
+done
 
 print_msg "=== Experiment 3: Fault Tolerance ==="
 
-run_experiment "exp3_rr_baseline" "rr" 8 30
-run_experiment "exp3_lrt_baseline" "lrt" 8 30
+for algo in $ALGOS; do
+    run_experiment "exp3_${algo}_baseline" "$algo" 8 30
+done
 
 print_msg "=== All experiments complete! ==="
 print_msg "Results saved in: $RESULTS_DIR/"
@@ -1,6 +1,12 @@
 #include "scheduler.h"
+#include "utils.h"
 #include <algorithm>
+#include <climits>
+#include <cmath>
+#include <limits>
+#include <random>
 #include <stdexcept>
+#include <thread>
 
 using namespace std;
 
@@ -24,23 +30,85 @@ bool Scheduler::empty()
   return request_queue.empty();
 }
 
-shared_ptr<Request> FCFSScheduler::get_next_request()
+static inline void cpu_relax()
 {
-  unique_lock<mutex> lock(queue_mutex);
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
 
-  queue_cv.wait(lock, [this]
-                { return !request_queue.empty() || shutdown; });
+FCFSScheduler::FCFSScheduler(size_t capacity) : ring(capacity), sleepers(0)
+{
+}
 
-  if (shutdown && request_queue.empty())
+void FCFSScheduler::add_request(shared_ptr<Request> req)
+{
+  while (!ring.try_push(move(req)))
   {
-    return nullptr;
+    this_thread::yield();
+  }
+  wake_worker();
+}
+
+bool FCFSScheduler::try_add_request(shared_ptr<Request> req)
+{
+  if (!ring.try_push(move(req)))
+  {
+    return false;
   }
+  wake_worker();
+  return true;
+}
 
-  auto req = request_queue.front();
-  request_queue.pop();
+void FCFSScheduler::wake_worker()
+{
+  // Pairs with the fence in get_next_request: either this load sees the
+  // parked worker or that worker's retry sees the new request.
+  atomic_thread_fence(memory_order_seq_cst);
+  if (sleepers.load(memory_order_relaxed) > 0)
+  {
+    lock_guard<mutex> lock(queue_mutex);
+    queue_cv.notify_one();
+  }
+}
+
+shared_ptr<Request> FCFSScheduler::get_next_request()
+{
+  shared_ptr<Request> req;
+
+  for (int i = 0; i < SPIN_ITERATIONS; ++i)
+  {
+    if (ring.try_pop(req))
+    {
+      return req;
+    }
+    cpu_relax();
+  }
+  for (int i = 0; i < YIELD_ITERATIONS; ++i)
+  {
+    if (ring.try_pop(req))
+    {
+      return req;
+    }
+    this_thread::yield();
+  }
+
+  unique_lock<mutex> lock(queue_mutex);
+  sleepers.fetch_add(1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  while (!ring.try_pop(req) && !shutdown)
+  {
+    queue_cv.wait(lock);
+  }
+  sleepers.fetch_sub(1, memory_order_relaxed);
   return req;
 }
 
+bool FCFSScheduler::empty()
+{
+  return ring.empty();
+}
+
 void SJFScheduler::add_request(shared_ptr<Request> req)
 {
   lock_guard<mutex> lock(queue_mutex);
@@ -96,8 +164,470 @@ void RRScheduler::requeue_request(shared_ptr<Request> req)
   queue_cv.notify_one();
 }
 
-unique_ptr<Scheduler> create_scheduler(SchedulingPolicy policy, int quantum)
+void RRScheduler::requeue_request(shared_ptr<Request> req, size_t worker_id)
+{
+  (void)worker_id;
+  requeue_request(req);
+}
+
+// Arrival times are measured from here so the aging term stays the size
+// of the waits being compared rather than the steady clock's uptime.
+static const long long scheduler_epoch_ns = get_current_time_ns();
+
+double srpt_priority(const Request &req, double aging_bytes_per_ms)
+{
+  size_t sent = req.file_data && req.type == RequestType::GET
+                    ? req.file_data->line_offset(req.lines_processed)
+                    : 0;
+  size_t remaining = req.type == RequestType::GET && req.file_size > sent
+                         ? req.file_size - sent
+                         : 0;
+  return remaining + aging_bytes_per_ms * ns_to_ms(req.arrival_time - scheduler_epoch_ns);
+}
+
+long long deadline_ns(const Request &req)
+{
+  if (req.deadline_ms <= 0)
+  {
+    return LLONG_MAX;
+  }
+  // DEADLINE accepts any positive long long; saturate rather than overflow.
+  if (req.deadline_ms > (LLONG_MAX - req.arrival_time) / 1'000'000LL)
+  {
+    return LLONG_MAX;
+  }
+  return req.arrival_time + req.deadline_ms * 1'000'000LL;
+}
+
+void EDFScheduler::add_request(shared_ptr<Request> req)
+{
+  lock_guard<mutex> lock(queue_mutex);
+  edf_queue.push({deadline_ns(*req), next_seq++, req});
+  queue_cv.notify_one();
+}
+
+shared_ptr<Request> EDFScheduler::get_next_request()
+{
+  unique_lock<mutex> lock(queue_mutex);
+
+  queue_cv.wait(lock, [this]
+                { return !edf_queue.empty() || shutdown; });
+
+  if (shutdown && edf_queue.empty())
+  {
+    return nullptr;
+  }
+
+  auto req = edf_queue.top().req;
+  edf_queue.pop();
+  return req;
+}
+
+bool EDFScheduler::empty()
+{
+  lock_guard<mutex> lock(queue_mutex);
+  return edf_queue.empty();
+}
+
+SRPTScheduler::SRPTScheduler(int q, double aging_bytes_per_ms)
+    : quantum(q), aging(aging_bytes_per_ms), next_seq(0)
+{
+}
+
+void SRPTScheduler::add_request(shared_ptr<Request> req)
+{
+  lock_guard<mutex> lock(queue_mutex);
+  srpt_queue.push({srpt_priority(*req, aging), next_seq++, req});
+  queue_cv.notify_one();
+}
+
+shared_ptr<Request> SRPTScheduler::get_next_request()
+{
+  unique_lock<mutex> lock(queue_mutex);
+
+  queue_cv.wait(lock, [this]
+                { return !srpt_queue.empty() || shutdown; });
+
+  if (shutdown && srpt_queue.empty())
+  {
+    return nullptr;
+  }
+
+  auto req = srpt_queue.top().req;
+  srpt_queue.pop();
+  return req;
+}
+
+bool SRPTScheduler::empty()
+{
+  lock_guard<mutex> lock(queue_mutex);
+  return srpt_queue.empty();
+}
+
+DRRScheduler::DRRScheduler(size_t quantum, unordered_map<string, double> client_weights)
+    : quantum_bytes(max<size_t>(quantum, 1)), weights(move(client_weights)), waiting(0)
+{
+}
+
+double DRRScheduler::weight_for(const string &key) const
+{
+  auto it = weights.find(key);
+  return it == weights.end() ? 1.0 : it->second;
+}
+
+void DRRScheduler::add_request(shared_ptr<Request> req)
+{
+  if (req->client_key.empty())
+  {
+    req->client_key = peer_address(req->client_id);
+  }
+
+  lock_guard<mutex> lock(queue_mutex);
+  Flow &flow = flows[req->client_key];
+  if (flow.requests.empty())
+  {
+    flow.weight = weight_for(req->client_key);
+    active.push_back(req->client_key);
+  }
+  flow.requests.push(move(req));
+  waiting++;
+  queue_cv.notify_one();
+}
+
+shared_ptr<Request> DRRScheduler::get_next_request()
+{
+  unique_lock<mutex> lock(queue_mutex);
+
+  queue_cv.wait(lock, [this]
+                { return waiting > 0 || shutdown; });
+
+  if (shutdown && waiting == 0)
+  {
+    return nullptr;
+  }
+
+  // The front client keeps the turn while its head request fits in its
+  // deficit; otherwise it is topped up and moves to the back. Rather than
+  // rotating one client at a time, which a tiny weight can stretch out
+  // indefinitely under queue_mutex, find the visit on which some head
+  // first fits: a client at position p that needs r top-ups is served on
+  // visit r * n + p. Apply every top-up before that visit at once.
+  auto head_cost = [](const Flow &flow)
+  {
+    return static_cast<double>(max<size_t>(flow.requests.front()->file_size, 1));
+  };
+
+  const Flow &front = flows.find(active.front())->second;
+  if (head_cost(front) > front.deficit)
+  {
+    size_t n = active.size();
+    double first_visit = numeric_limits<double>::infinity();
+    size_t winner = 0;
+    for (size_t p = 0; p < n; ++p)
+    {
+      const Flow &flow = flows.find(active[p])->second;
+      double shortfall = head_cost(flow) - flow.deficit;
+      double rounds = shortfall > 0 ? ceil(shortfall / (quantum_bytes * flow.weight)) : 0;
+      double visit = rounds * n + p;
+      if (visit < first_visit)
+      {
+        first_visit = visit;
+        winner = p;
+      }
+    }
+
+    for (size_t p = 0; p < n; ++p)
+    {
+      double top_ups = ceil((first_visit - p) / n);
+      if (top_ups > 0)
+      {
+        Flow &flow = flows.find(active[p])->second;
+        flow.deficit += top_ups * quantum_bytes * flow.weight;
+      }
+    }
+    rotate(active.begin(), active.begin() + winner, active.end());
+  }
+
+  auto it = flows.find(active.front());
+  Flow &flow = it->second;
+  auto &head = flow.requests.front();
+  flow.deficit = max(0.0, flow.deficit - head_cost(flow));
+  auto req = move(head);
+  flow.requests.pop();
+  waiting--;
+
+  FlowStats &stats = served[it->first];
+  stats.weight = flow.weight;
+  stats.requests++;
+  stats.bytes += req->file_size;
+
+  if (flow.requests.empty())
+  {
+    active.pop_front();
+    flows.erase(it);
+  }
+  return req;
+}
+
+bool DRRScheduler::empty()
 {
+  lock_guard<mutex> lock(queue_mutex);
+  return waiting == 0;
+}
+
+unordered_map<string, FlowStats> DRRScheduler::flow_stats()
+{
+  lock_guard<mutex> lock(queue_mutex);
+  return served;
+}
+
+MLFQScheduler::MLFQScheduler(int base_quantum, int level_count, int boost_interval_ms)
+    : levels(max(level_count, 1)), stats(max(level_count, 1)),
+      boost_interval_ns(boost_interval_ms * 1'000'000LL), last_boost(get_current_time_ns()),
+      waiting(0)
+{
+  for (size_t i = 0; i < stats.size(); ++i)
+  {
+    stats[i].quantum_ms = base_quantum << min<size_t>(i, 16);
+  }
+}
+
+void MLFQScheduler::enqueue(shared_ptr<Request> req, int level)
+{
+  req->priority_level = level;
+  req->queued_time = get_current_time_ns();
+  levels[level].push(move(req));
+  waiting++;
+  queue_cv.notify_one();
+}
+
+void MLFQScheduler::boost(long long now)
+{
+  for (size_t i = 1; i < levels.size(); ++i)
+  {
+    while (!levels[i].empty())
+    {
+      levels[i].front()->priority_level = 0;
+      levels[0].push(move(levels[i].front()));
+      levels[i].pop();
+    }
+  }
+  last_boost = now;
+}
+
+void MLFQScheduler::add_request(shared_ptr<Request> req)
+{
+  lock_guard<mutex> lock(queue_mutex);
+  enqueue(move(req), 0);
+}
+
+void MLFQScheduler::requeue_request(shared_ptr<Request> req, size_t worker_id)
+{
+  (void)worker_id;
+  lock_guard<mutex> lock(queue_mutex);
+  int level = min<int>(req->priority_level + 1, levels.size() - 1);
+  if (level != req->priority_level)
+  {
+    stats[req->priority_level].demotions++;
+  }
+  enqueue(move(req), level);
+}
+
+shared_ptr<Request> MLFQScheduler::get_next_request()
+{
+  unique_lock<mutex> lock(queue_mutex);
+
+  queue_cv.wait(lock, [this]
+                { return waiting > 0 || shutdown; });
+
+  if (shutdown && waiting == 0)
+  {
+    return nullptr;
+  }
+
+  long long now = get_current_time_ns();
+  if (boost_interval_ns > 0 && now - last_boost >= boost_interval_ns)
+  {
+    boost(now);
+  }
+
+  for (size_t i = 0; i < levels.size(); ++i)
+  {
+    if (levels[i].empty())
+    {
+      continue;
+    }
+    auto req = move(levels[i].front());
+    levels[i].pop();
+    waiting--;
+
+    long long wait = now - req->queued_time;
+    stats[i].dispatches++;
+    stats[i].total_wait_ns += wait;
+    stats[i].max_wait_ns = max(stats[i].max_wait_ns, wait);
+    return req;
+  }
+  return nullptr;
+}
+
+bool MLFQScheduler::empty()
+{
+  lock_guard<mutex> lock(queue_mutex);
+  return waiting == 0;
+}
+
+vector<MLFQLevelStats> MLFQScheduler::level_stats()
+{
+  lock_guard<mutex> lock(queue_mutex);
+  return stats;
+}
+
+WorkStealingScheduler::WorkStealingScheduler(SchedulingPolicy sched_policy,
+                                             const SchedulerOptions &options)
+    : policy(sched_policy), quantum(options.quantum), aging(options.aging_bytes_per_ms),
+      next_queue(0), queued(0), sleepers(0), local_pops(0), steals(0)
+{
+  for (size_t i = 0; i < max<size_t>(options.steal_workers, 1); ++i)
+  {
+    queues.push_back(make_unique<LocalQueue>());
+  }
+}
+
+void WorkStealingScheduler::push(size_t index, shared_ptr<Request> req)
+{
+  LocalQueue &q = *queues[index % queues.size()];
+  {
+    lock_guard<mutex> lock(q.lock);
+    if (policy == SchedulingPolicy::SJF)
+    {
+      auto pos = upper_bound(q.requests.begin(), q.requests.end(), req,
+                             [](const shared_ptr<Request> &a, const shared_ptr<Request> &b)
+                             { return a->file_size < b->file_size; });
+      q.requests.insert(pos, move(req));
+    }
+    else if (policy == SchedulingPolicy::SRPT)
+    {
+      double priority = srpt_priority(*req, aging);
+      auto pos = upper_bound(q.requests.begin(), q.requests.end(), priority,
+                             [this](double p, const shared_ptr<Request> &b)
+                             { return p < srpt_priority(*b, aging); });
+      q.requests.insert(pos, move(req));
+    }
+    else
+    {
+      q.requests.push_back(move(req));
+    }
+  }
+
+  queued.fetch_add(1, memory_order_seq_cst);
+  if (sleepers.load(memory_order_seq_cst) > 0)
+  {
+    lock_guard<mutex> lock(queue_mutex);
+    queue_cv.notify_one();
+  }
+}
+
+bool WorkStealingScheduler::pop(size_t index, shared_ptr<Request> &req)
+{
+  LocalQueue &q = *queues[index];
+  lock_guard<mutex> lock(q.lock);
+  if (q.requests.empty())
+  {
+    return false;
+  }
+  req = move(q.requests.front());
+  q.requests.pop_front();
+  queued.fetch_sub(1, memory_order_relaxed);
+  return true;
+}
+
+bool WorkStealingScheduler::steal(size_t thief, shared_ptr<Request> &req)
+{
+  static thread_local minstd_rand rng(random_device{}());
+  size_t n = queues.size();
+  size_t start = rng() % n;
+  for (size_t i = 0; i < n; ++i)
+  {
+    size_t victim = (start + i) % n;
+    if (victim != thief && pop(victim, req))
+    {
+      steals++;
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingScheduler::add_request(shared_ptr<Request> req)
+{
+  push(next_queue.fetch_add(1, memory_order_relaxed), move(req));
+}
+
+void WorkStealingScheduler::requeue_request(shared_ptr<Request> req, size_t worker_id)
+{
+  push(worker_id, move(req));
+}
+
+shared_ptr<Request> WorkStealingScheduler::get_next_request()
+{
+  return get_next_request(0);
+}
+
+shared_ptr<Request> WorkStealingScheduler::get_next_request(size_t worker_id)
+{
+  size_t self = worker_id % queues.size();
+  shared_ptr<Request> req;
+
+  while (true)
+  {
+    if (pop(self, req))
+    {
+      local_pops++;
+      return req;
+    }
+    for (int round = 0; round < STEAL_ROUNDS; ++round)
+    {
+      if (steal(self, req))
+      {
+        return req;
+      }
+      this_thread::yield();
+    }
+
+    unique_lock<mutex> lock(queue_mutex);
+    sleepers.fetch_add(1, memory_order_seq_cst);
+    while (queued.load(memory_order_seq_cst) == 0 && !shutdown)
+    {
+      queue_cv.wait(lock);
+    }
+    sleepers.fetch_sub(1, memory_order_seq_cst);
+    if (shutdown && queued.load() == 0)
+    {
+      return nullptr;
+    }
+  }
+}
+
+bool WorkStealingScheduler::empty()
+{
+  return queued.load() == 0;
+}
+
+static unique_ptr<Scheduler> make_scheduler(SchedulingPolicy policy,
+                                            const SchedulerOptions &options)
+{
+  if (options.steal_workers > 0)
+  {
+    if (policy == SchedulingPolicy::MLFQ || policy == SchedulingPolicy::EDF ||
+        policy == SchedulingPolicy::DRR)
+    {
+      throw runtime_error("Work stealing does not support MLFQ, EDF or DRR");
+    }
+    return make_unique<WorkStealingScheduler>(policy, options);
+  }
+
+  int quantum = options.quantum;
+
   switch (policy)
   {
   case SchedulingPolicy::FCFS:
@@ -105,16 +635,43 @@ unique_ptr<Scheduler> create_scheduler(SchedulingPolicy policy, int quantum)
   case SchedulingPolicy::SJF:
     return make_unique<SJFScheduler>();
   case SchedulingPolicy::RR:
-    if (quantum <= 0)
-    {
-      throw runtime_error("Round Robin requires positive quantum value");
-    }
     return make_unique<RRScheduler>(quantum);
+  case SchedulingPolicy::SRPT:
+    return make_unique<SRPTScheduler>(quantum, options.aging_bytes_per_ms);
+  case SchedulingPolicy::DRR:
+    return make_unique<DRRScheduler>(options.drr_quantum_bytes, options.client_weights);
+  case SchedulingPolicy::EDF:
+    return make_unique<EDFScheduler>(quantum);
+  case SchedulingPolicy::MLFQ:
+    return make_unique<MLFQScheduler>(quantum, options.mlfq_levels,
+                                      options.boost_interval_ms);
   default:
     throw runtime_error("Unknown scheduling policy");
   }
 }
 
+unique_ptr<Scheduler> create_scheduler(SchedulingPolicy policy, const SchedulerOptions &options)
+{
+  bool preemptive = policy == SchedulingPolicy::RR || policy == SchedulingPolicy::SRPT ||
+                    policy == SchedulingPolicy::MLFQ || policy == SchedulingPolicy::EDF;
+  if (policy == SchedulingPolicy::RR && options.quantum <= 0 && options.quantum_bytes == 0)
+  {
+    throw runtime_error("Round Robin requires a positive time or byte quantum");
+  }
+  if ((policy == SchedulingPolicy::SRPT || policy == SchedulingPolicy::MLFQ) &&
+      options.quantum <= 0)
+  {
+    throw runtime_error("Preemptive scheduling requires positive quantum value");
+  }
+
+  unique_ptr<Scheduler> scheduler = make_scheduler(policy, options);
+  if (preemptive)
+  {
+    scheduler->set_slice_bytes(options.quantum_bytes);
+  }
+  return scheduler;
+}
+
 SchedulingPolicy parse_policy(const string &policy_str)
 {
   string lower = policy_str;
@@ -126,7 +683,15 @@ SchedulingPolicy parse_policy(const string &policy_str)
     return SchedulingPolicy::SJF;
   if (lower == "rr")
     return SchedulingPolicy::RR;
+  if (lower == "srpt")
+    return SchedulingPolicy::SRPT;
+  if (lower == "mlfq")
+    return SchedulingPolicy::MLFQ;
+  if (lower == "edf")
+    return SchedulingPolicy::EDF;
+  if (lower == "drr")
+    return SchedulingPolicy::DRR;
 
   throw runtime_error("Invalid scheduling policy: " + policy_str +
-                      " (must be fcfs, sjf, or rr)");
+                      " (must be fcfs, sjf, rr, srpt, mlfq, edf, or drr)");
 }
\ No newline at end of file
@@ -2,46 +2,155 @@
 #define SCHEDULER_H
 
 #include "protocol.h"
+#include "mpmc_ring.h"
+#include <atomic>
 #include <queue>
 #include <mutex>
 #include <condition_variable>
+#include <deque>
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 using namespace std;
 
 enum class SchedulingPolicy {
     FCFS,
   SJF,
-    RR
+    RR,
+    SRPT,
+    MLFQ,
+    EDF,
+    DRR
 };
 
+struct SchedulerOptions {
+    int quantum = 0;
+    size_t quantum_bytes = 0;
+    size_t steal_workers = 0;
+    double aging_bytes_per_ms = 1000.0;
+    int mlfq_levels = 3;
+    int boost_interval_ms = 200;
+    size_t drr_quantum_bytes = 65536;
+    unordered_map<string, double> client_weights;
+};
+
+// SRPT priority: bytes left to send, plus aging * ms from scheduler start
+// to arrival. A request is overtaken only by ones arriving less than
+// remaining / aging ms after it. Lower runs first.
+double srpt_priority(const Request &req, double aging_bytes_per_ms);
+
+// Absolute deadline in steady-clock ns, or LLONG_MAX without one or when
+// it lies beyond what a long long can hold.
+long long deadline_ns(const Request &req);
+
+// Concrete schedulers are final so that worker_loop<Policy> in server.cpp,
+// instantiated per policy once main() has picked one, calls them directly
+// instead of through the vtable. The loop only calls members a policy
+// declares itself, and checks the traits below to decide which ones.
 class Scheduler {
 protected:
     queue<shared_ptr<Request>> request_queue;
   mutex queue_mutex;
 condition_variable queue_cv;
     bool shutdown;
+    size_t slice_bytes;
     
 public:
-    Scheduler() : shutdown(false) {}
+    // Workers must use get_next_request(worker_id) and requeue through it.
+    static constexpr bool PER_WORKER_QUEUES = false;
+    // quantum_for / slice_bytes_for depend on the request.
+    static constexpr bool PER_REQUEST_SLICES = false;
+
+    Scheduler() : shutdown(false), slice_bytes(0) {}
     virtual ~Scheduler() {}
     
   virtual void add_request(shared_ptr<Request> req);
+
+    // Admission from the event loops, which must not block: false means
+    // the queue is full and the request was not taken.
+    virtual bool try_add_request(shared_ptr<Request> req)
+    {
+        add_request(move(req));
+        return true;
+    }
     
     virtual shared_ptr<Request> get_next_request() = 0;
+
+    // Workers pass their index so per-worker schedulers can serve and
+    // requeue locally; shared-queue schedulers ignore it.
+    virtual shared_ptr<Request> get_next_request(size_t worker_id)
+    {
+        (void)worker_id;
+        return get_next_request();
+    }
+
+    virtual void requeue_request(shared_ptr<Request> req, size_t worker_id)
+    {
+        (void)worker_id;
+        add_request(req);
+    }
+
+    // Preemption quantum in ms; 0 means requests run to completion.
+    virtual int get_quantum() const { return 0; }
+
+    // Quantum for this request's next slice, for policies where it varies.
+    virtual int quantum_for(const Request &req) const
+    {
+        (void)req;
+        return get_quantum();
+    }
+
+    // Byte budget per slice for preemptive policies; 0 means slices are
+    // bounded by time only. With both set, a slice ends at whichever
+    // limit it reaches first.
+    void set_slice_bytes(size_t bytes) { slice_bytes = bytes; }
+    size_t get_slice_bytes() const { return slice_bytes; }
+
+    virtual size_t slice_bytes_for(const Request &req) const
+    {
+        (void)req;
+        return slice_bytes;
+    }
+
+    bool is_preemptive() const { return get_quantum() > 0 || slice_bytes > 0; }
+
+    // Whether workers should fail requests whose deadline passed while
+    // they were queued instead of serving them.
+    virtual bool drops_expired() const { return false; }
     
-    void signal_shutdown();
+    virtual void signal_shutdown();
     
-  bool empty();
+  virtual bool empty();
 };
 
-class FCFSScheduler : public Scheduler {
+// FCFS over a lock-free ring. Idle workers spin, then yield, then park on
+// queue_cv; producers take queue_mutex only when a worker is parked. New
+// requests are refused once the ring holds capacity of them.
+class FCFSScheduler final : public Scheduler {
+private:
+    static const size_t DEFAULT_CAPACITY = 65536;
+    static const int SPIN_ITERATIONS = 128;
+    static const int YIELD_ITERATIONS = 16;
+
+    MPMCRing<shared_ptr<Request>> ring;
+    atomic<int> sleepers;
+
 public:
+    explicit FCFSScheduler(size_t capacity = DEFAULT_CAPACITY);
+
+    void add_request(shared_ptr<Request> req) override;
+    bool try_add_request(shared_ptr<Request> req) override;
     shared_ptr<Request> get_next_request() override;
+    using Scheduler::get_next_request;
+    bool empty() override;
+
+private:
+    void wake_worker();
 };
 
-class SJFScheduler : public Scheduler {
+class SJFScheduler final : public Scheduler {
 private:
     struct SJFComparator {
         bool operator()(const shared_ptr<Request>& a, 
@@ -57,9 +166,10 @@ private:
 public:
     void add_request(shared_ptr<Request> req) override;
   shared_ptr<Request> get_next_request() override;
+  using Scheduler::get_next_request;
 };
 
-class RRScheduler : public Scheduler {
+class RRScheduler final : public Scheduler {
 private:
     int quantum;
   queue<shared_ptr<Request>> rr_queue;
@@ -69,13 +179,228 @@ public:
     
     void add_request(shared_ptr<Request> req) override;
     shared_ptr<Request> get_next_request() override;
+    using Scheduler::get_next_request;
     
     void requeue_request(shared_ptr<Request> req);
+    void requeue_request(shared_ptr<Request> req, size_t worker_id) override;
     
-  int get_quantum() const { return quantum; }
+  int get_quantum() const override { return quantum; }
+};
+
+// Shortest remaining processing time. Requests run one quantum at a time
+// and are requeued with their remaining bytes, so a long GET is preempted
+// at the next chunk boundary once something shorter is waiting.
+class SRPTScheduler final : public Scheduler {
+private:
+    struct Entry {
+        double priority;
+        long long seq;
+        shared_ptr<Request> req;
+    };
+
+    struct EntryComparator {
+        bool operator()(const Entry &a, const Entry &b) const
+        {
+            return a.priority > b.priority || (a.priority == b.priority && a.seq > b.seq);
+        }
+    };
+
+    int quantum;
+    double aging;
+    long long next_seq;
+    priority_queue<Entry, vector<Entry>, EntryComparator> srpt_queue;
+
+public:
+    SRPTScheduler(int q, double aging_bytes_per_ms);
+
+    void add_request(shared_ptr<Request> req) override;
+    shared_ptr<Request> get_next_request() override;
+    using Scheduler::get_next_request;
+    void requeue_request(shared_ptr<Request> req, size_t worker_id) override
+    {
+        (void)worker_id;
+        add_request(move(req));
+    }
+    bool empty() override;
+
+    int get_quantum() const override { return quantum; }
+};
+
+// Earliest deadline first. Requests without a DEADLINE line sort after
+// all that have one, in arrival order. With a quantum, GETs are sliced and
+// requeued like RR so a newly arrived tighter deadline can overtake them.
+class EDFScheduler final : public Scheduler {
+private:
+    struct Entry {
+        long long deadline;
+        long long seq;
+        shared_ptr<Request> req;
+    };
+
+    struct EntryComparator {
+        bool operator()(const Entry &a, const Entry &b) const
+        {
+            return a.deadline > b.deadline || (a.deadline == b.deadline && a.seq > b.seq);
+        }
+    };
+
+    int quantum;
+    long long next_seq;
+    priority_queue<Entry, vector<Entry>, EntryComparator> edf_queue;
+
+public:
+    explicit EDFScheduler(int q) : quantum(q), next_seq(0) {}
+
+    void add_request(shared_ptr<Request> req) override;
+    shared_ptr<Request> get_next_request() override;
+    using Scheduler::get_next_request;
+    void requeue_request(shared_ptr<Request> req, size_t worker_id) override
+    {
+        (void)worker_id;
+        add_request(move(req));
+    }
+    bool empty() override;
+
+    int get_quantum() const override { return quantum; }
+    bool drops_expired() const override { return true; }
+};
+
+struct FlowStats {
+    double weight = 1.0;
+    long long requests = 0;
+    long long bytes = 0;
+};
+
+// Deficit round robin across clients (Request::client_key, or the peer
+// address when no CLIENT line was sent). Each turn a backlogged client's
+// deficit grows by quantum * weight bytes and its queued requests run
+// while their size fits, so clients share bytes served in proportion to
+// their weights no matter how many requests each one has queued.
+class DRRScheduler final : public Scheduler {
+private:
+    struct Flow {
+        queue<shared_ptr<Request>> requests;
+        double deficit = 0;
+        double weight = 1.0;
+    };
+
+    size_t quantum_bytes;
+    unordered_map<string, double> weights;
+    unordered_map<string, Flow> flows;
+    deque<string> active;
+    unordered_map<string, FlowStats> served;
+    size_t waiting;
+
+    double weight_for(const string &key) const;
+
+public:
+    DRRScheduler(size_t quantum, unordered_map<string, double> client_weights);
+
+    void add_request(shared_ptr<Request> req) override;
+    shared_ptr<Request> get_next_request() override;
+    using Scheduler::get_next_request;
+    bool empty() override;
+
+    unordered_map<string, FlowStats> flow_stats();
+};
+
+struct MLFQLevelStats {
+    int quantum_ms = 0;
+    long long dispatches = 0;
+    long long demotions = 0;
+    long long total_wait_ns = 0;
+    long long max_wait_ns = 0;
+};
+
+// Multi-level feedback queue. New requests enter level 0 with the base
+// quantum; a request that uses its whole slice drops a level, and each
+// level below doubles the quantum. Every boost interval all waiting
+// requests move back to level 0 so large transfers still make progress.
+class MLFQScheduler final : public Scheduler {
+private:
+    vector<queue<shared_ptr<Request>>> levels;
+    vector<MLFQLevelStats> stats;
+    long long boost_interval_ns;
+    long long last_boost;
+    size_t waiting;
+
+    void enqueue(shared_ptr<Request> req, int level);
+    void boost(long long now);
+
+public:
+    static constexpr bool PER_REQUEST_SLICES = true;
+
+    MLFQScheduler(int base_quantum, int level_count, int boost_interval_ms);
+
+    void add_request(shared_ptr<Request> req) override;
+    shared_ptr<Request> get_next_request() override;
+    using Scheduler::get_next_request;
+    void requeue_request(shared_ptr<Request> req, size_t worker_id) override;
+    bool empty() override;
+
+    int get_quantum() const override { return stats[0].quantum_ms; }
+    int quantum_for(const Request &req) const override
+    {
+        return stats[min<size_t>(req.priority_level, stats.size() - 1)].quantum_ms;
+    }
+    size_t slice_bytes_for(const Request &req) const override
+    {
+        return slice_bytes << min<size_t>(req.priority_level, 16);
+    }
+
+    vector<MLFQLevelStats> level_stats();
+};
+
+// Per-worker deques for FCFS, SJF, RR and SRPT. New requests are spread
+// round-robin across workers. Each deque is ordered by the policy: FIFO
+// for FCFS and RR, smallest file first for SJF, srpt_priority for SRPT.
+// A worker serves its own deque first and requeues its preempted requests
+// there. When that is empty it steals the head of a random victim's deque,
+// and parks only if there is nothing to steal.
+class WorkStealingScheduler final : public Scheduler {
+private:
+    static const int STEAL_ROUNDS = 2;
+
+    struct LocalQueue {
+        mutex lock;
+        deque<shared_ptr<Request>> requests;
+    };
+
+    SchedulingPolicy policy;
+    int quantum;
+    double aging;
+    vector<unique_ptr<LocalQueue>> queues;
+    atomic<size_t> next_queue;
+    atomic<long long> queued;
+    atomic<int> sleepers;
+    atomic<long long> local_pops;
+    atomic<long long> steals;
+
+    void push(size_t index, shared_ptr<Request> req);
+    bool pop(size_t index, shared_ptr<Request> &req);
+    bool steal(size_t thief, shared_ptr<Request> &req);
+
+public:
+    static constexpr bool PER_WORKER_QUEUES = true;
+
+    WorkStealingScheduler(SchedulingPolicy sched_policy, const SchedulerOptions &options);
+
+    void add_request(shared_ptr<Request> req) override;
+    shared_ptr<Request> get_next_request() override;
+    shared_ptr<Request> get_next_request(size_t worker_id) override;
+    void requeue_request(shared_ptr<Request> req, size_t worker_id) override;
+    bool empty() override;
+
+    int get_quantum() const override
+    {
+        return (policy == SchedulingPolicy::RR || policy == SchedulingPolicy::SRPT) ? quantum : 0;
+    }
+    long long get_local_pops() const { return local_pops; }
+    long long get_steals() const { return steals; }
 };
 
-unique_ptr<Scheduler> create_scheduler(SchedulingPolicy policy, int quantum = 0);
+unique_ptr<Scheduler> create_scheduler(SchedulingPolicy policy,
+                                       const SchedulerOptions &options = SchedulerOptions());
 
 SchedulingPolicy parse_policy(const string& policy_str);
 
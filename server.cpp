@@ -1,11 +1,14 @@
 #include "config.h"
+#include "file_store.h"
 #include "protocol.h"
 #include "scheduler.h"
+#include "server_reactor.h"
 #include "utils.h"
 #include <iostream>
 #include <thread>
 #include <vector>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <atomic>
 #include <csignal>
@@ -16,21 +19,24 @@
 #include <cstring>
 #include <fstream>
 #include <getopt.h>
+#include <fcntl.h>
 
 using namespace std;
 
-map<string, vector<string>> file_storage;
-mutex storage_mutex;
+unique_ptr<FileStore> file_store;
 
 vector<Request> completed_requests;
 mutex metrics_mutex;
 
-int packet_size = 10;
+Packetization packetization;
 unique_ptr<Scheduler> scheduler;
 
 atomic<bool> shutdown_requested(false);
 int global_server_sock = -1;
 
+vector<unique_ptr<ServerReactor>> reactors;
+atomic<size_t> next_reactor(0);
+
 void signal_handler(int signum)
 {
     cout << "\n[Server] Received signal " << signum << ", shutting down..." << endl;
@@ -48,38 +54,39 @@ void signal_handler(int signum)
     }
 }
 
-void store_file(const string &filename, const vector<string> &lines)
+void store_file(const string &filename, shared_ptr<const FileBlob> file)
 {
-    lock_guard<mutex> lock(storage_mutex);
-    file_storage[filename] = lines;
+    size_t line_count = file->line_count();
+    file_store->put(filename, move(file));
     cout << "[Server] Stored file: " << filename
-         << " (" << lines.size() << " lines)" << endl;
+         << " (" << line_count << " lines)" << endl;
 }
 
-bool retrieve_file(const string &filename, vector<string> &lines)
+shared_ptr<const FileBlob> retrieve_file(const string &filename)
 {
-    lock_guard<mutex> lock(storage_mutex);
-    auto it = file_storage.find(filename);
-    if (it == file_storage.end())
-    {
-        return false;
-    }
+    return file_store->get(filename);
+}
 
-    lines = it->second;
-    return true;
+void record_completed(const Request &request)
+{
+    Request record = request;
+    record.file_data.reset();
+
+    lock_guard<mutex> lock(metrics_mutex);
+    completed_requests.push_back(move(record));
 }
 
 bool handle_put(int client_sock, Request &request)
 {
-    store_file(request.filename, request.file_lines);
+    store_file(request.filename, request.file_data);
 
     return send_line(client_sock, PROTOCOL_OK);
 }
 
 bool handle_get(int client_sock, Request &request)
 {
-    vector<string> lines;
-    if (!retrieve_file(request.filename, lines))
+    shared_ptr<const FileBlob> file = request.file_data;
+    if (!file)
     {
         send_line(client_sock, PROTOCOL_ERROR + " File not found");
         return false;
@@ -90,14 +97,54 @@ bool handle_get(int client_sock, Request &request)
         return false;
     }
 
-    size_t file_size = get_file_size(lines);
+    if (!send_line(client_sock, PROTOCOL_SIZE + " " + to_string(file->size())))
+    {
+        return false;
+    }
+
+    return send_file(client_sock, *file, packetization);
+}
 
-    if (!send_line(client_sock, PROTOCOL_SIZE + " " + to_string(file_size)))
+void park_connection(int client_sock)
+{
+    if (reactors.empty())
+    {
+        close(client_sock);
+        return;
+    }
+    size_t index = next_reactor.fetch_add(1, memory_order_relaxed) % reactors.size();
+    reactors[index]->resume(client_sock);
+}
+
+void finish_connection(const Request &request, bool success)
+{
+    if (request.keep_alive && success && !shutdown_requested)
+    {
+        park_connection(request.client_id);
+    }
+    else
+    {
+        close(request.client_id);
+    }
+}
+
+// Fails a request whose deadline passed before any worker reached it, so
+// the slot goes to one that can still make its deadline.
+bool drop_expired(const shared_ptr<Request> &request)
+{
+    if (request->start_time != 0 || get_current_time_ns() <= deadline_ns(*request))
     {
         return false;
     }
 
-    return send_file(client_sock, lines, packet_size);
+    request->dropped = true;
+    request->start_time = request->finish_time = get_current_time_ns();
+    send_line(request->client_id, PROTOCOL_ERROR + " Deadline exceeded");
+    record_completed(*request);
+    cout << "[Worker] Dropped " << request->filename << " (deadline "
+         << request->deadline_ms << " ms exceeded)" << endl;
+    finish_connection(*request, false);
+    return true;
 }
 
 void process_request(shared_ptr<Request> request, int client_sock)
@@ -116,10 +163,7 @@ void process_request(shared_ptr<Request> request, int client_sock)
 
     request->finish_time = get_current_time_ns();
 
-    {
-        lock_guard<mutex> lock(metrics_mutex);
-        completed_requests.push_back(*request);
-    }
+    record_completed(*request);
 
     if (success)
     {
@@ -130,57 +174,93 @@ void process_request(shared_ptr<Request> request, int client_sock)
              << " ms)" << endl;
     }
 
-    close(client_sock);
+    finish_connection(*request, success);
 }
 
-bool process_request_chunk_timed(shared_ptr<Request> request)
+// Sends the next slice of a request: until quantum_ns elapses or budget
+// bytes are sent, whichever comes first (0 disables either limit).
+bool process_request_chunk_timed(shared_ptr<Request> request, long long quantum_ns,
+                                 size_t budget, bool &success)
 {
+    success = false;
     if (request->type == RequestType::PUT)
     {
-        store_file(request->filename, request->file_lines);
-        send_line(request->client_id, PROTOCOL_OK);
+        store_file(request->filename, request->file_data);
+        success = send_line(request->client_id, PROTOCOL_OK);
         return true;
     }
     else if (request->type == RequestType::GET)
     {
+        if (!request->file_data)
+        {
+            send_line(request->client_id, PROTOCOL_ERROR + " File not found");
+            return true;
+        }
 
         if (request->lines_processed == 0)
         {
-            if (!send_line(request->client_id, PROTOCOL_OK))
-            {
-                return true;
-            }
-            if (!send_line(request->client_id, PROTOCOL_SIZE + " " + to_string(request->file_size)))
+            string header = PROTOCOL_OK + "\n" + PROTOCOL_SIZE + " " +
+                            to_string(request->file_size) + "\n";
+            if (!send_bytes(request->client_id, header))
             {
                 return true;
             }
         }
 
-        RRScheduler *rr_sched = dynamic_cast<RRScheduler *>(scheduler.get());
-        long long quantum_ms = rr_sched ? rr_sched->get_quantum() : 10;
-        long long quantum_ns = quantum_ms * 1'000'000LL;
-        auto chunk_start_time = chrono::steady_clock::now();
+        if (quantum_ns <= 0 && budget == 0)
+        {
+            quantum_ns = 10'000'000LL;
+        }
+        auto chunk_start_time = quantum_ns > 0 ? chrono::steady_clock::now()
+                                               : chrono::steady_clock::time_point();
+        size_t slice_sent = 0;
+
+        const FileBlob &file = *request->file_data;
+        if (request->lines_processed >= file.line_count())
+        {
+            success = send_line(request->client_id, PROTOCOL_END);
+            return true;
+        }
 
         while (true)
         {
-            if (request->lines_processed >= request->file_lines.size())
+            // Whole lines per send, so a preempted request always resumes on
+            // a line boundary. A byte-only slice goes out as one write; a
+            // timed slice is split into packets so the clock can stop it.
+            size_t begin = file.line_offset(request->lines_processed);
+            size_t packet = quantum_ns > 0 ? static_cast<size_t>(packetization.max_bytes)
+                                           : budget - slice_sent;
+            if (budget > 0)
             {
-                send_line(request->client_id, PROTOCOL_END);
-                return true;
+                packet = min(packet, budget - slice_sent);
             }
+            size_t limit = begin + packet;
+            size_t next = limit >= file.size() ? file.line_count() : file.line_at_offset(limit);
+            if (packetization.max_lines > 0)
+            {
+                next = min<size_t>(next, request->lines_processed + packetization.max_lines);
+            }
+            next = max(next, request->lines_processed + 1);
 
-            const string &line_to_send = request->file_lines[request->lines_processed];
-            if (!send_line(request->client_id, line_to_send))
+            size_t end = file.line_offset(next);
+            if (!send_file_range(request->client_id, file, begin, end))
             {
                 return true;
             }
-            request->lines_processed++;
-
-            auto elapsed_ns = chrono::duration_cast<chrono::nanoseconds>(
-                                  chrono::steady_clock::now() - chunk_start_time)
-                                  .count();
+            request->lines_processed = next;
+            slice_sent += end - begin;
 
-            if (elapsed_ns >= quantum_ns)
+            if (next == file.line_count())
+            {
+                success = true;
+                return true;
+            }
+            if (budget > 0 && slice_sent >= budget)
+            {
+                break;
+            }
+            if (quantum_ns > 0 && chrono::steady_clock::now() - chunk_start_time >=
+                                      chrono::nanoseconds(quantum_ns))
             {
                 break;
             }
@@ -191,40 +271,61 @@ bool process_request_chunk_timed(shared_ptr<Request> request)
     return true;
 }
 
-void worker_thread()
+// One instantiation per concrete scheduler, so the calls below bind
+// statically; start_workers() picks the instantiation once at startup.
+template <typename Policy>
+void worker_loop(Policy *sched, size_t worker_id)
 {
+    bool preemptive = sched->is_preemptive();
+    bool drops_expired = sched->drops_expired();
+    long long quantum_ns = sched->get_quantum() * 1'000'000LL;
+    size_t budget = sched->get_slice_bytes();
+
     while (true)
     {
-        auto request = scheduler->get_next_request();
+        shared_ptr<Request> request;
+        if constexpr (Policy::PER_WORKER_QUEUES)
+        {
+            request = sched->get_next_request(worker_id);
+        }
+        else
+        {
+            request = sched->get_next_request();
+        }
         if (!request)
         {
             break;
         }
+        if (drops_expired && drop_expired(request))
+        {
+            continue;
+        }
 
-        RRScheduler *rr_sched = dynamic_cast<RRScheduler *>(scheduler.get());
-
-        if (rr_sched)
+        if (preemptive)
         {
             if (request->start_time == 0)
             {
                 request->start_time = get_current_time_ns();
             }
 
-            bool is_complete = process_request_chunk_timed(request);
+            bool success = false;
+            if constexpr (Policy::PER_REQUEST_SLICES)
+            {
+                quantum_ns = sched->quantum_for(*request) * 1'000'000LL;
+                budget = sched->slice_bytes_for(*request);
+            }
+            bool is_complete = process_request_chunk_timed(request, quantum_ns, budget, success);
 
             if (is_complete)
             {
                 request->finish_time = get_current_time_ns();
-                {
-                    lock_guard<mutex> lock(metrics_mutex);
-                    completed_requests.push_back(*request);
-                }
-                cout << "[Worker] Completed (RR) " << request->filename << endl;
-                close(request->client_id);
+                record_completed(*request);
+                cout << "[Worker] Completed (preemptive) " << request->filename << endl;
+                finish_connection(*request, success);
             }
             else
             {
-                rr_sched->requeue_request(request);
+                sched->requeue_request(request, worker_id);
             }
         }
         else
@@ -235,84 +336,83 @@ void worker_thread()
     }
 }
 
-void acceptor_thread(int server_sock)
+template <typename Policy>
+bool start_workers_as(Scheduler *sched, size_t count, vector<thread> &workers)
 {
-    while (!shutdown_requested)
+    auto *concrete = dynamic_cast<Policy *>(sched);
+    if (!concrete)
     {
-        struct sockaddr_in client_addr;
-        socklen_t client_len = sizeof(client_addr);
-
-        int client_sock = accept(server_sock, (struct sockaddr *)&client_addr, &client_len);
-
-        if (shutdown_requested)
-        {
-            break;
-        }
-
-        if (client_sock < 0)
-        {
-            continue;
-        }
-
-        cout << "[Server] Accepted connection from "
-             << inet_ntoa(client_addr.sin_addr) << endl;
-        string first_line;
-        char buffer[1024];
-        ssize_t bytes_peeked = recv(client_sock, buffer, sizeof(buffer) - 1, MSG_PEEK);
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+        workers.emplace_back(worker_loop<Policy>, concrete, i);
+    }
+    return true;
+}
 
-        if (bytes_peeked > 0)
-        {
-            buffer[bytes_peeked] = '\0';
-            string peeked_data(buffer);
-            size_t newline_pos = peeked_data.find('\n');
-            if (newline_pos != string::npos)
-            {
-                first_line = peeked_data.substr(0, newline_pos);
-            }
-        }
+void start_workers(Scheduler *sched, size_t count, vector<thread> &workers)
+{
+    bool started =
+        start_workers_as<FCFSScheduler>(sched, count, workers) ||
+        start_workers_as<SJFScheduler>(sched, count, workers) ||
+        start_workers_as<RRScheduler>(sched, count, workers) ||
+        start_workers_as<SRPTScheduler>(sched, count, workers) ||
+        start_workers_as<EDFScheduler>(sched, count, workers) ||
+        start_workers_as<DRRScheduler>(sched, count, workers) ||
+        start_workers_as<MLFQScheduler>(sched, count, workers) ||
+        start_workers_as<WorkStealingScheduler>(sched, count, workers);
+    if (!started)
+    {
+        throw runtime_error("No worker loop for this scheduler");
+    }
+}
 
-        if (first_line == PROTOCOL_HEALTH)
+void admit_request(shared_ptr<Request> request)
+{
+    if (request->type == RequestType::GET)
+    {
+        request->file_data = retrieve_file(request->filename);
+        if (request->file_data)
         {
-            string health_line;
-            recv_line(client_sock, health_line);
-
-            send_line(client_sock, PROTOCOL_HEALTH_OK);
-            close(client_sock);
-
-            cout << "[Server] Responded to health check" << endl;
-            continue;
+            request->file_size = request->file_data->size();
         }
-
-        auto request = make_shared<Request>();
-        request->arrival_time = get_current_time_ns();
-
-        if (!parse_request(client_sock, *request))
+        else
         {
-            cerr << "[Server] Failed to parse request" << endl;
-            send_line(client_sock, PROTOCOL_ERROR + " Malformed request");
-            close(client_sock);
-            continue;
+            request->file_size = 0;
         }
+    }
+    if (!scheduler->try_add_request(request))
+    {
+        cerr << "[Server] Queue full, refusing " << request->filename << endl;
+        send_line(request->client_id, PROTOCOL_ERROR + " Server busy");
+        close(request->client_id);
+    }
+}
 
-        request->client_id = client_sock;
-
-        if (request->type == RequestType::GET)
-        {
-            vector<string> lines;
-            if (retrieve_file(request->filename, lines))
-            {
-                request->file_size = get_file_size(lines);
-                request->file_lines = lines;
-            }
-            else
-            {
-                request->file_size = 0;
-            }
-        }
-        scheduler->add_request(request);
+void reactor_thread(ServerReactor *reactor)
+{
+    try
+    {
+        reactor->run();
+    }
+    catch (const exception &e)
+    {
+        cerr << "[Server] Event loop failed: " << e.what() << endl;
     }
+}
 
-    cout << "[Server] Acceptor thread exiting" << endl;
+const char *deadline_status(const Request &req)
+{
+    if (req.deadline_ms <= 0)
+    {
+        return "none";
+    }
+    if (req.dropped)
+    {
+        return "dropped";
+    }
+    return req.finish_time <= deadline_ns(req) ? "hit" : "miss";
 }
 
 void save_metrics(const string &filename)
@@ -325,7 +425,7 @@ void save_metrics(const string &filename)
     }
 
     file << "request_type,filename,file_size,arrival_time_ns,start_time_ns,finish_time_ns,"
-         << "response_time_ms,waiting_time_ms\n";
+         << "response_time_ms,waiting_time_ms,deadline_ms,deadline_status,client\n";
 
     lock_guard<mutex> lock(metrics_mutex);
     for (const auto &req : completed_requests)
@@ -339,21 +439,111 @@ void save_metrics(const string &filename)
              << req.start_time << ","
              << req.finish_time << ","
              << response_time << ","
-             << waiting_time << "\n";
+             << waiting_time << ","
+             << req.deadline_ms << ","
+             << deadline_status(req) << ","
+             << req.client_key << "\n";
     }
 
     file.close();
     cout << "[Server] Saved metrics to " << filename << endl;
 }
 
+// Queueing delay per MLFQ level, counted on every dispatch (a preempted
+// request waits once per slice).
+void save_level_metrics(const string &filename, const vector<MLFQLevelStats> &levels)
+{
+    ofstream file(filename);
+    if (!file.is_open())
+    {
+        cerr << "Error: Cannot create level metrics file" << endl;
+        return;
+    }
+
+    file << "level,quantum_ms,dispatches,demotions,mean_wait_ms,max_wait_ms\n";
+    for (size_t i = 0; i < levels.size(); ++i)
+    {
+        const MLFQLevelStats &level = levels[i];
+        double mean_wait = level.dispatches > 0
+                               ? ns_to_ms(level.total_wait_ns) / level.dispatches
+                               : 0.0;
+        file << i << ","
+             << level.quantum_ms << ","
+             << level.dispatches << ","
+             << level.demotions << ","
+             << mean_wait << ","
+             << ns_to_ms(level.max_wait_ns) << "\n";
+
+        cout << "[Server] MLFQ level " << i << " (" << level.quantum_ms << " ms): "
+             << level.dispatches << " dispatches, " << level.demotions << " demotions, "
+             << "mean wait " << mean_wait << " ms, max " << ns_to_ms(level.max_wait_ns)
+             << " ms" << endl;
+    }
+
+    file.close();
+    cout << "[Server] Saved level metrics to " << filename << endl;
+}
+
+void print_storage_stats()
+{
+    StoreStats stats = file_store->stats();
+    cout << "[Server] Storage: " << stats.entries << " files, " << stats.bytes
+         << " bytes in " << stats.shards.size() << " shards, "
+         << stats.contended << " contended lock acquisitions" << endl;
+
+    for (size_t i = 0; i < stats.shards.size(); ++i)
+    {
+        const ShardStats &shard = stats.shards[i];
+        cout << "[Server]   shard " << i << ": " << shard.entries << " files, "
+             << shard.bytes << " bytes, " << shard.reads << " reads, "
+             << shard.writes << " writes, " << shard.contended << " contended" << endl;
+    }
+}
+
+bool parse_weights(const string &list, unordered_map<string, double> &weights)
+{
+    size_t pos = 0;
+    while (pos < list.size())
+    {
+        size_t comma = list.find(',', pos);
+        string item = list.substr(pos, comma == string::npos ? string::npos : comma - pos);
+        size_t eq = item.find('=');
+        if (eq == string::npos || eq == 0)
+        {
+            return false;
+        }
+        double weight = atof(item.c_str() + eq + 1);
+        if (weight <= 0)
+        {
+            return false;
+        }
+        weights[item.substr(0, eq)] = weight;
+        pos = comma == string::npos ? list.size() : comma + 1;
+    }
+    return !weights.empty();
+}
+
 void print_usage(const char *prog_name)
 {
     cout << "Usage: " << prog_name << " [options]\n"
          << "Options:\n"
-         << "  --sched <policy>    Scheduling policy (fcfs, sjf, rr) [required]\n"
-         << "  --quantum <Q>       Time quantum for RR (required if --sched rr)\n"
+         << "  --sched <policy>    Scheduling policy (fcfs, sjf, rr, srpt, mlfq, edf, drr)\n"
+         << "                      [required]\n"
+         << "  --quantum <Q>       Time quantum in ms (required for rr, default 5 for srpt,\n"
+         << "                      default 2 for the top mlfq level, optional for edf)\n"
+         << "  --quantum-bytes <B> Byte budget per slice for preemptive policies; alone it\n"
+         << "                      satisfies rr, with --quantum a slice ends at either limit\n"
+         << "  --aging <B>         SRPT aging: bytes of priority gained per ms waited (default 1000)\n"
          << "  --file <path>       Input file or directory [required]\n"
-         << "  --p <N>             Packetization parameter (lines per packet) [required]\n"
+         << "  --packet-bytes <B>  Bytes per send on GET responses (default 65536)\n"
+         << "  --p <N>             Also cap each send at N lines (legacy packetization)\n"
+         << "  --shards <N>        Storage shards, each with its own lock (default 16)\n"
+         << "  --io-threads <N>    Event loops reading requests (default 1)\n"
+         << "  --levels <N>        MLFQ levels; each level doubles the quantum (default 3)\n"
+         << "  --boost <MS>        MLFQ priority boost interval in ms, 0 disables (default 200)\n"
+         << "  --weights <list>    DRR client weights, e.g. interactive=4,batch=1 (default 1)\n"
+         << "  --drr-quantum <B>   DRR bytes added per client turn before weighting (default 65536)\n"
+         << "  --steal             Per-worker queues with work stealing (fcfs, sjf, rr, srpt)\n"
          << "  --help              Show this help message\n";
 }
 
@@ -361,21 +551,43 @@ int main(int argc, char *argv[])
 {
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
+    signal(SIGPIPE, SIG_IGN);
 
     string sched_policy_str;
     int quantum = 0;
+    long long quantum_bytes = 0;
     string file_path;
+    int packet_size = 0;
+    long long packet_bytes = DEFAULT_PACKET_BYTES;
+    int shard_count = 16;
+    int io_threads = 1;
+    bool work_stealing = false;
+    double aging = SchedulerOptions().aging_bytes_per_ms;
+    int mlfq_levels = SchedulerOptions().mlfq_levels;
+    int boost_ms = SchedulerOptions().boost_interval_ms;
+    long long drr_quantum = SchedulerOptions().drr_quantum_bytes;
+    unordered_map<string, double> client_weights;
 
     static struct option long_options[] = {
         {"sched", required_argument, 0, 's'},
         {"quantum", required_argument, 0, 'q'},
+        {"quantum-bytes", required_argument, 0, 'Q'},
         {"file", required_argument, 0, 'f'},
         {"p", required_argument, 0, 'p'},
+        {"packet-bytes", required_argument, 0, 'b'},
+        {"shards", required_argument, 0, 'n'},
+        {"io-threads", required_argument, 0, 'i'},
+        {"steal", no_argument, 0, 'w'},
+        {"aging", required_argument, 0, 'a'},
+        {"levels", required_argument, 0, 'l'},
+        {"boost", required_argument, 0, 'B'},
+        {"weights", required_argument, 0, 'W'},
+        {"drr-quantum", required_argument, 0, 'D'},
         {"help", no_argument, 0, 'h'},
         {0, 0, 0, 0}};
 
     int opt;
-    while ((opt = getopt_long(argc, argv, "s:q:f:p:h", long_options, nullptr)) != -1)
+    while ((opt = getopt_long(argc, argv, "s:q:Q:f:p:b:n:i:wa:l:B:W:D:h", long_options, nullptr)) != -1)
     {
         switch (opt)
         {
@@ -385,12 +597,46 @@ int main(int argc, char *argv[])
         case 'q':
             quantum = atoi(optarg);
             break;
+        case 'Q':
+            quantum_bytes = atoll(optarg);
+            break;
         case 'f':
             file_path = optarg;
             break;
         case 'p':
             packet_size = atoi(optarg);
             break;
+        case 'b':
+            packet_bytes = atoll(optarg);
+            break;
+        case 'n':
+            shard_count = atoi(optarg);
+            break;
+        case 'i':
+            io_threads = atoi(optarg);
+            break;
+        case 'w':
+            work_stealing = true;
+            break;
+        case 'a':
+            aging = atof(optarg);
+            break;
+        case 'l':
+            mlfq_levels = atoi(optarg);
+            break;
+        case 'B':
+            boost_ms = atoi(optarg);
+            break;
+        case 'W':
+            if (!parse_weights(optarg, client_weights))
+            {
+                cerr << "Error: --weights expects id=weight[,id=weight...]\n";
+                return 1;
+            }
+            break;
+        case 'D':
+            drr_quantum = atoll(optarg);
+            break;
         case 'h':
             print_usage(argv[0]);
             return 0;
@@ -400,7 +646,10 @@ int main(int argc, char *argv[])
         }
     }
 
-    if (sched_policy_str.empty() || file_path.empty() || packet_size <= 0)
+    if (sched_policy_str.empty() || file_path.empty() || packet_size < 0 || packet_bytes <= 0 ||
+        shard_count <= 0 || io_threads <= 0 || aging < 0 ||
+        mlfq_levels <= 0 || boost_ms < 0 || drr_quantum <= 0 ||
+        quantum_bytes < 0)
     {
         cerr << "Error: Missing required arguments\n";
         print_usage(argv[0]);
@@ -418,9 +667,24 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    if (policy == SchedulingPolicy::RR && quantum <= 0)
+    if (policy == SchedulingPolicy::RR && quantum <= 0 && quantum_bytes <= 0)
     {
-        cerr << "Error: --quantum required for Round Robin scheduling\n";
+        cerr << "Error: --quantum or --quantum-bytes required for Round Robin scheduling\n";
+        return 1;
+    }
+    if (policy == SchedulingPolicy::SRPT && quantum <= 0)
+    {
+        quantum = 5;
+    }
+    if (policy == SchedulingPolicy::MLFQ && quantum <= 0)
+    {
+        quantum = 2;
+    }
+    if ((policy == SchedulingPolicy::MLFQ || policy == SchedulingPolicy::EDF ||
+         policy == SchedulingPolicy::DRR) &&
+        work_stealing)
+    {
+        cerr << "Error: --steal is not supported with --sched mlfq, edf or drr\n";
         return 1;
     }
 
@@ -439,16 +703,50 @@ int main(int argc, char *argv[])
          << "IP: " << config.server_ip << "\n"
          << "Port: " << config.server_port << "\n"
          << "Worker threads: " << config.server_threads << "\n"
-         << "Scheduling policy: " << sched_policy_str << "\n";
+         << "Scheduling policy: " << sched_policy_str
+         << (work_stealing ? " (work stealing)" : "") << "\n";
 
-    if (policy == SchedulingPolicy::RR)
+    if (quantum > 0 && (policy == SchedulingPolicy::RR || policy == SchedulingPolicy::SRPT ||
+                        policy == SchedulingPolicy::MLFQ || policy == SchedulingPolicy::EDF))
     {
         cout << "Quantum: " << quantum << "\n";
     }
+    if (quantum_bytes > 0)
+    {
+        cout << "Quantum bytes: " << quantum_bytes << "\n";
+    }
+    if (policy == SchedulingPolicy::MLFQ)
+    {
+        cout << "MLFQ levels: " << mlfq_levels << ", boost every " << boost_ms << " ms\n";
+    }
+    if (policy == SchedulingPolicy::SRPT)
+    {
+        cout << "Aging: " << aging << " bytes/ms\n";
+    }
+    if (policy == SchedulingPolicy::DRR)
+    {
+        cout << "DRR quantum: " << drr_quantum << " bytes";
+        for (const auto &weight : client_weights)
+        {
+            cout << ", " << weight.first << "=" << weight.second;
+        }
+        cout << "\n";
+    }
+
+    packetization.max_bytes = packet_bytes;
+    packetization.max_lines = packet_size;
 
-    cout << "Packetization: " << packet_size << " lines/packet\n"
-         << "===========================\n"
+    cout << "Packetization: " << packet_bytes << " bytes/packet";
+    if (packet_size > 0)
+    {
+        cout << ", at most " << packet_size << " lines";
+    }
+    cout << "\nStorage shards: " << shard_count
+         << "\nI/O threads: " << io_threads
+         << "\n===========================\n"
          << endl;
+
+    file_store = make_unique<FileStore>(shard_count);
     if (is_directory(file_path))
     {
         vector<string> files;
@@ -456,24 +754,33 @@ int main(int argc, char *argv[])
         {
             for (const auto &file : files)
             {
-                vector<string> lines;
-                if (read_file_lines(file, lines))
+                auto blob = make_shared<FileBlob>();
+                if (read_file_lines(file, *blob))
                 {
-                    store_file(get_filename(file), lines);
+                    store_file(get_filename(file), move(blob));
                 }
             }
         }
     }
     else
     {
-        vector<string> lines;
-        if (read_file_lines(file_path, lines))
+        auto blob = make_shared<FileBlob>();
+        if (read_file_lines(file_path, *blob))
         {
-            store_file(get_filename(file_path), lines);
+            store_file(get_filename(file_path), move(blob));
         }
     }
 
-    scheduler = create_scheduler(policy, quantum);
+    SchedulerOptions sched_options;
+    sched_options.quantum = quantum;
+    sched_options.quantum_bytes = quantum_bytes;
+    sched_options.steal_workers = work_stealing ? config.server_threads : 0;
+    sched_options.aging_bytes_per_ms = aging;
+    sched_options.mlfq_levels = mlfq_levels;
+    sched_options.boost_interval_ms = boost_ms;
+    sched_options.drr_quantum_bytes = drr_quantum;
+    sched_options.client_weights = client_weights;
+    scheduler = create_scheduler(policy, sched_options);
     int server_sock = socket(AF_INET, SOCK_STREAM, 0);
     if (server_sock < 0)
     {
@@ -507,16 +814,41 @@ int main(int argc, char *argv[])
 
     cout << "[Server] Listening on " << config.server_ip
          << ":" << config.server_port << endl;
+    fcntl(server_sock, F_SETFL, fcntl(server_sock, F_GETFL, 0) | O_NONBLOCK);
+
+    // Build the reactors before any thread starts, so a failure here can
+    // return without joinable workers.
+    try
+    {
+        for (int i = 0; i < io_threads; ++i)
+        {
+            reactors.push_back(make_unique<ServerReactor>(server_sock, shutdown_requested,
+                                                          admit_request));
+        }
+    }
+    catch (const exception &e)
+    {
+        cerr << "Error: " << e.what() << endl;
+        reactors.clear();
+        close(server_sock);
+        return 1;
+    }
+
     vector<thread> workers;
-    for (int i = 0; i < config.server_threads; ++i)
+    start_workers(scheduler.get(), config.server_threads, workers);
+
+    vector<thread> io_loops;
+    for (auto &reactor : reactors)
     {
-        workers.emplace_back(worker_thread);
+        io_loops.emplace_back(reactor_thread, reactor.get());
     }
-    thread acceptor(acceptor_thread, server_sock);
 
     cout << "[Server] Press Ctrl+C to stop...\n"
          << endl;
-    acceptor.join();
+    for (auto &loop : io_loops)
+    {
+        loop.join();
+    }
 
     cout << "[Server] Waiting for workers to finish..." << endl;
     for (auto &worker : workers)
@@ -531,8 +863,29 @@ int main(int argc, char *argv[])
         close(global_server_sock);
     }
 
+    print_storage_stats();
+
+    if (auto *ws = dynamic_cast<WorkStealingScheduler *>(scheduler.get()))
+    {
+        cout << "[Server] Work stealing: " << ws->get_local_pops() << " local pops, "
+             << ws->get_steals() << " steals" << endl;
+    }
+
     cout << "[Server] Saving metrics..." << endl;
     save_metrics("metrics.csv");
+    if (auto *mlfq = dynamic_cast<MLFQScheduler *>(scheduler.get()))
+    {
+        save_level_metrics("metrics_levels.csv", mlfq->level_stats());
+    }
+    if (auto *drr = dynamic_cast<DRRScheduler *>(scheduler.get()))
+    {
+        for (const auto &flow : drr->flow_stats())
+        {
+            cout << "[Server] Client " << flow.first << " (weight " << flow.second.weight
+                 << "): " << flow.second.requests << " requests, " << flow.second.bytes
+                 << " bytes" << endl;
+        }
+    }
     cout << "[Server] Shutdown complete" << endl;
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,326 @@
+#include "server_reactor.h"
+#include "utils.h"
+#include <iostream>
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+using namespace std;
+
+static bool set_blocking(int fd, bool blocking)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0)
+    {
+        return false;
+    }
+    flags = blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+    return fcntl(fd, F_SETFL, flags) == 0;
+}
+
+ServerReactor::ServerReactor(int listen_sock, atomic<bool> &shutdown_flag,
+                             RequestHandler request_handler)
+    : listen_fd(listen_sock), epoll_fd(-1), wake_fd(-1), shutdown(shutdown_flag),
+      handler(request_handler), read_buffer(READ_CHUNK), last_sweep_ns(get_current_time_ns())
+{
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || wake_fd < 0)
+    {
+        throw runtime_error("Cannot create event loop: " + string(strerror(errno)));
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.ptr = nullptr;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &ev) < 0)
+    {
+        throw runtime_error("Cannot register listening socket: " + string(strerror(errno)));
+    }
+
+    ev.events = EPOLLIN;
+    ev.data.ptr = this;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) < 0)
+    {
+        throw runtime_error("Cannot register wake fd: " + string(strerror(errno)));
+    }
+}
+
+ServerReactor::~ServerReactor()
+{
+    for (auto &entry : connections)
+    {
+        close(entry.first);
+    }
+    {
+        lock_guard<mutex> lock(pending_lock);
+        for (int fd : pending)
+        {
+            close(fd);
+        }
+    }
+    if (wake_fd >= 0)
+    {
+        close(wake_fd);
+    }
+    if (epoll_fd >= 0)
+    {
+        close(epoll_fd);
+    }
+}
+
+void ServerReactor::run()
+{
+    struct epoll_event events[MAX_EVENTS];
+
+    while (!shutdown)
+    {
+        int n = epoll_wait(epoll_fd, events, MAX_EVENTS, 100);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            cerr << "[Server] epoll_wait failed: " << strerror(errno) << endl;
+            break;
+        }
+
+        for (int i = 0; i < n; ++i)
+        {
+            void *ptr = events[i].data.ptr;
+            if (ptr == nullptr)
+            {
+                accept_connections();
+            }
+            else if (ptr == this)
+            {
+                adopt_pending();
+            }
+            else
+            {
+                on_readable(static_cast<Connection *>(ptr));
+            }
+        }
+
+        long long now = get_current_time_ns();
+        if (now - last_sweep_ns >= SWEEP_INTERVAL_MS * 1'000'000LL)
+        {
+            last_sweep_ns = now;
+            expire_idle(now);
+        }
+    }
+
+    cout << "[Server] Event loop exiting (" << connections.size()
+         << " connections still open)" << endl;
+}
+
+// Called from worker threads after a keep-alive response.
+void ServerReactor::resume(int fd)
+{
+    {
+        lock_guard<mutex> lock(pending_lock);
+        pending.push_back(fd);
+    }
+    uint64_t one = 1;
+    if (write(wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+    {
+        cerr << "[Server] Cannot wake event loop: " << strerror(errno) << endl;
+    }
+}
+
+void ServerReactor::adopt_pending()
+{
+    uint64_t count;
+    while (read(wake_fd, &count, sizeof(count)) > 0)
+    {
+    }
+
+    vector<int> fds;
+    {
+        lock_guard<mutex> lock(pending_lock);
+        fds.swap(pending);
+    }
+    for (int fd : fds)
+    {
+        if (!set_blocking(fd, false))
+        {
+            close(fd);
+            continue;
+        }
+        watch(fd);
+    }
+}
+
+void ServerReactor::expire_idle(long long now)
+{
+    vector<Connection *> expired;
+    for (auto &entry : connections)
+    {
+        Connection *conn = entry.second.get();
+        if (conn->framer.started() &&
+            now - conn->last_active_ns >= IDLE_TIMEOUT_MS * 1'000'000LL)
+        {
+            expired.push_back(conn);
+        }
+    }
+
+    for (auto *conn : expired)
+    {
+        cerr << "[Server] Closing connection idle for " << IDLE_TIMEOUT_MS << " ms" << endl;
+        send_line(conn->fd, PROTOCOL_ERROR + " Request timed out");
+        close_connection(conn);
+    }
+}
+
+void ServerReactor::accept_connections()
+{
+    while (!shutdown)
+    {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+
+        int client_sock = accept4(listen_fd, (struct sockaddr *)&client_addr, &client_len,
+                                  SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_sock < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK && !shutdown)
+            {
+                cerr << "[Server] accept failed: " << strerror(errno) << endl;
+            }
+            return;
+        }
+
+        cout << "[Server] Accepted connection from "
+             << inet_ntoa(client_addr.sin_addr) << endl;
+
+        watch(client_sock);
+    }
+}
+
+void ServerReactor::watch(int fd)
+{
+    auto conn = make_unique<Connection>();
+    conn->fd = fd;
+    conn->arrival_ns = 0;
+    conn->last_active_ns = get_current_time_ns();
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN | EPOLLRDHUP;
+    ev.data.ptr = conn.get();
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+    {
+        close(fd);
+        return;
+    }
+    connections[fd] = move(conn);
+}
+
+// Level-triggered: read a bounded number of chunks per wakeup so one large
+// upload cannot starve accepts and other connections on this loop.
+void ServerReactor::on_readable(Connection *conn)
+{
+    for (int i = 0; i < MAX_READS_PER_EVENT; ++i)
+    {
+        ssize_t received = recv(conn->fd, read_buffer.data(), read_buffer.size(), 0);
+        if (received < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                close_connection(conn);
+            }
+            return;
+        }
+
+        if (received == 0)
+        {
+            if (conn->framer.started())
+            {
+                cerr << "[Server] Failed to parse request" << endl;
+                send_line(conn->fd, PROTOCOL_ERROR + " Malformed request");
+            }
+            close_connection(conn);
+            return;
+        }
+
+        conn->last_active_ns = get_current_time_ns();
+        if (!conn->framer.started())
+        {
+            conn->arrival_ns = conn->last_active_ns;
+        }
+        size_t used = conn->framer.feed(read_buffer.data(), received);
+
+        if (conn->framer.failed())
+        {
+            cerr << "[Server] Failed to parse request" << endl;
+            send_line(conn->fd, PROTOCOL_ERROR + " Malformed request");
+            close_connection(conn);
+            return;
+        }
+        if (used < static_cast<size_t>(received))
+        {
+            cerr << "[Server] Bytes after a complete request" << endl;
+            send_line(conn->fd, PROTOCOL_ERROR + " Pipelined requests are not supported");
+            close_connection(conn);
+            return;
+        }
+        if (conn->framer.done())
+        {
+            dispatch(conn);
+            return;
+        }
+    }
+}
+
+void ServerReactor::dispatch(Connection *conn)
+{
+    int fd = conn->fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+
+    if (conn->framer.is_health())
+    {
+        send_line(fd, PROTOCOL_HEALTH_OK);
+        close(fd);
+        connections.erase(fd);
+
+        cout << "[Server] Responded to health check" << endl;
+        return;
+    }
+
+    shared_ptr<Request> request = conn->framer.take_request();
+    request->arrival_time = conn->arrival_ns;
+    request->client_id = fd;
+    connections.erase(fd);
+
+    if (!set_blocking(fd, true))
+    {
+        close(fd);
+        return;
+    }
+    handler(request);
+}
+
+void ServerReactor::close_connection(Connection *conn)
+{
+    int fd = conn->fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections.erase(fd);
+}
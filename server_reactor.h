@@ -0,0 +1,72 @@
+#ifndef SERVER_REACTOR_H
+#define SERVER_REACTOR_H
+
+#include "protocol.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+using RequestHandler = function<void(shared_ptr<Request>)>;
+
+// Single-threaded epoll loop for the backend server. Several loops may
+// share the listening socket. A connection is read without blocking until
+// RequestFramer has a whole request; the socket is then made blocking,
+// removed from the loop and handed to the handler (the scheduler). HEALTH
+// probes are answered inline. Keep-alive connections come back through
+// resume() once their response is sent. Requests are not pipelined: bytes
+// after a framed request are answered with ERROR.
+class ServerReactor {
+private:
+    static const size_t READ_CHUNK = 64 * 1024;
+    static const int MAX_READS_PER_EVENT = 4;
+    static const int MAX_EVENTS = 256;
+    // A connection that started a request and sent nothing more for this
+    // long is closed, checked every SWEEP_INTERVAL_MS. Connections between
+    // requests are left alone: the LB's pool keeps idle ones open on
+    // purpose and times them out itself.
+    static const long long IDLE_TIMEOUT_MS = 30000;
+    static const long long SWEEP_INTERVAL_MS = 1000;
+
+    struct Connection {
+        int fd;
+        long long arrival_ns;
+        long long last_active_ns;
+        RequestFramer framer;
+    };
+
+    int listen_fd;
+    int epoll_fd;
+    int wake_fd;
+    atomic<bool> &shutdown;
+    RequestHandler handler;
+
+    unordered_map<int, unique_ptr<Connection>> connections;
+    vector<char> read_buffer;
+
+    mutex pending_lock;
+    vector<int> pending;
+
+    long long last_sweep_ns;
+
+    void accept_connections();
+    void adopt_pending();
+    void watch(int fd);
+    void expire_idle(long long now);
+    void on_readable(Connection *conn);
+    void dispatch(Connection *conn);
+    void close_connection(Connection *conn);
+
+public:
+    ServerReactor(int listen_sock, atomic<bool> &shutdown_flag, RequestHandler request_handler);
+    ~ServerReactor();
+
+    void run();
+    void resume(int fd);
+};
+
+#endif
@@ -36,7 +36,7 @@ for i in 1 2 3 4; do
     echo -e "${GREEN}Starting Backend Server ${i} on port ${port}${NC}"
     
     cp config_server${i}.json config.json
-    $SERVER_BIN --sched fcfs --p 10 --file $TEST_DIR > backend${i}.log 2>&1 &
+    $SERVER_BIN --sched fcfs --packet-bytes 65536 --file $TEST_DIR > backend${i}.log 2>&1 &
     echo $! > backend${i}.pid
     
     sleep 1
@@ -1,5 +1,6 @@
 #include "utils.h"
 #include <fstream>
+#include <iterator>
 #include <sys/stat.h>
 #include <dirent.h>
 #include <iostream>
@@ -18,54 +19,32 @@ double ns_to_ms(long long ns)
   return static_cast<double>(ns) / 1000000.0;
 }
 
-bool read_file_lines(const string &filename, vector<string> &lines)
+bool read_file_lines(const string &filename, FileBlob &file)
 {
-  ifstream file(filename);
-  if (!file.is_open())
+  ifstream in(filename, ios::binary);
+  if (!in.is_open())
   {
     cerr << "Error: Cannot open file " << filename << endl;
     return false;
   }
 
-  lines.clear();
-  string line;
-  while (getline(file, line))
-  {
-    lines.push_back(line);
-  }
-
-  file.close();
+  file.assign(string(istreambuf_iterator<char>(in), istreambuf_iterator<char>()));
   return true;
 }
 
-bool write_file_lines(const string &filename, const vector<string> &lines)
+bool write_file_lines(const string &filename, const FileBlob &file)
 {
-  ofstream file(filename);
-  if (!file.is_open())
+  ofstream out(filename, ios::binary);
+  if (!out.is_open())
   {
     cerr << "Error: Cannot create file " << filename << endl;
     return false;
   }
 
-  for (const auto &line : lines)
-  {
-    file << line << "\n";
-  }
-
-  file.close();
+  out.write(file.bytes().data(), file.size());
   return true;
 }
 
-size_t get_file_size(const vector<string> &lines)
-{
-  size_t size = 0;
-  for (const auto &line : lines)
-  {
-    size += line.length() + 1;
-  }
-  return size;
-}
-
 bool is_directory(const string &path)
 {
   struct stat statbuf;
@@ -1,6 +1,7 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include "file_blob.h"
 #include <string>
 #include <vector>
 #include <chrono>
@@ -11,11 +12,9 @@ long long get_current_time_ns();
 
 double ns_to_ms(long long ns);
 
-bool read_file_lines(const string& filename, vector<string>& lines);
+bool read_file_lines(const string& filename, FileBlob& file);
 
-bool write_file_lines(const string& filename, const vector<string>& lines);
-
-size_t get_file_size(const vector<string>& lines);
+bool write_file_lines(const string& filename, const FileBlob& file);
 
 bool list_files(const string& dir_path, vector<string>& files);
 